@@ -0,0 +1,159 @@
+#include "./analyzer.h"
+
+#include <algorithm>
+#include <exception>
+#include <optional>
+
+#include "./error.h"
+#include "./eval_env.h"
+#include "./forms.h"
+
+namespace {
+
+void addName(std::vector<SymbolId>& names, SymbolId id) {
+    if (std::ranges::find(names, id) == names.end()) names.push_back(id);
+}
+
+// names bound by the defines of a body that run whenever it does: those of
+// the body itself and of the begin forms in it. Other defines, e.g. in a
+// branch of an if, bind their name when they run, and it is looked up by
+// name, so a name that was never defined is still found further out.
+void collectDefines(const ValuePtr& expr, std::vector<SymbolId>& names) {
+    if (!Value::isPair(expr) || !Value::isList(expr)) return;
+    auto head = SpecialForm::formOf(expr);
+    auto form = expr.toVector();
+
+    if (head == SpecialForm::beginForm) {
+        for (std::size_t i = 1; i < form.size(); ++i)
+            collectDefines(form[i], names);
+    } else if (head == SpecialForm::defineForm && form.size() >= 2) {
+        if (Value::isSymbol(form[1])) {
+            addName(names, form[1].asSymbolId());
+        } else if (Value::isPair(form[1]) && Value::isList(form[1]) &&
+                   Value::isSymbol(form[1].toVector()[0])) {
+            addName(names, form[1].toVector()[0].asSymbolId());
+        }
+    }
+}
+
+}  // namespace
+
+NodePtr Analyzer::constant(ValuePtr val) {
+    return makeNode(
+        [val = Pinned(val)](EvalEnv&, TailCall*) { return val.get(); });
+}
+
+NodePtr Analyzer::analyze(const ValuePtr& expr) {
+    auto depth = scopes.size();
+    try {
+        return analyzeExpr(expr);
+    } catch (Error&) {
+        scopes.resize(depth);
+        auto error = std::current_exception();
+        return makeNode([error](EvalEnv&, TailCall*) -> ValuePtr {
+            std::rethrow_exception(error);
+        });
+    }
+}
+
+NodePtr Analyzer::analyzeExpr(const ValuePtr& expr) {
+    switch (expr.getType()) {
+        case ValueType::NUMERIC:
+        case ValueType::BOOLEAN:
+        case ValueType::STRING:
+        case ValueType::VECTOR: return constant(expr);
+        case ValueType::NIL: throw LispError("Evaluating nil is prohibited");
+        case ValueType::SYMBOL: return analyzeVariable(expr.asSymbolId());
+        case ValueType::PAIR: break;
+        default: throw LispError("Unknown expression: " + expr.toString());
+    }
+
+    if (!Value::isList(expr))
+        throw LispError("Malformed list: " + expr.toString());
+
+    auto ls = expr.cast<PairValue>();
+    // operands are not analyzed here, the special form decides how
+    if (auto form = SpecialForm::formOf(expr))
+        return form(ls->cdr().toVector(), *this);
+    return analyzeApplication(ls->car(), ls->cdr());
+}
+
+NodePtr Analyzer::analyzeVariable(SymbolId name) const {
+    std::uint32_t depth = 0;
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it, ++depth) {
+        int found = (*it)->slotOf(name);
+        if (found < 0) continue;
+
+        auto slot = static_cast<std::uint32_t>(found);
+        return makeNode([depth, slot](EvalEnv& env, TailCall*) {
+            return env.lookupLocal(depth, slot);
+        });
+    }
+    return makeNode([name](EvalEnv& env, TailCall*) {
+        return env.lookupBinding(name);
+    });
+}
+
+NodePtr Analyzer::analyzeApplication(const ValuePtr& head,
+                                     const ValuePtr& operands) {
+    // any other head is taken as is: procedure objects may head code built
+    // at run time, everything else fails once the call runs
+    auto proc = Value::isList(head) || Value::isSymbol(head) ? analyze(head)
+                                                             : constant(head);
+    std::vector<NodePtr> args;
+    for (auto& operand : operands.toVector()) args.push_back(analyze(operand));
+
+    return makeNode([proc, args](EvalEnv& env, TailCall* tail) {
+        auto func = proc->exec(env);
+        if (!Value::isProcedure(func))
+            throw TypeError(func.toString() + " is not a procedure");
+
+        // the procedure may be a fresh closure, only reachable from here
+        ArgBuffer callee;
+        callee.push(func);
+        ArgBuffer values;
+        for (auto& arg : args) values.push(arg->exec(env));
+        if (func.getType() != ValueType::LAMBDA)
+            return env.apply(std::move(func), values.args());
+
+        if (!tail) return env.applyLambda(std::move(func), values.args());
+        tail->proc = std::move(func);
+        // reuses the storage of the previous tail call
+        auto vals = values.args();
+        tail->args.assign(vals.begin(), vals.end());
+        tail->pending = true;
+        return ValuePtr::nil();
+    });
+}
+
+NodePtr Analyzer::analyzeSequence(const std::vector<ValuePtr>& exprs) {
+    std::vector<NodePtr> nodes;
+    for (auto& expr : exprs) nodes.push_back(analyze(expr));
+    if (nodes.size() == 1) return nodes.front();
+
+    return makeNode([nodes](EvalEnv& env, TailCall* tail) {
+        for (std::size_t i = 0; i != nodes.size() - 1; ++i)
+            nodes[i]->exec(env);
+        return nodes.back()->exec(env, tail);
+    });
+}
+
+ValuePtr Analyzer::makeScope(const std::vector<SymbolId>& params,
+                            const std::vector<ValuePtr>& body) {
+    std::vector<SymbolId> names{params};
+    for (auto& expr : body) collectDefines(expr, names);
+    return Value::make<ScopeValue>(names, params.size());
+}
+
+std::pair<ValuePtr, NodePtr> Analyzer::analyzeScope(
+    const std::vector<SymbolId>& params, const std::vector<ValuePtr>& body) {
+    auto scope = makeScope(params, body);
+    scopes.push_back(scope.cast<ScopeValue>());
+    auto node = analyzeSequence(body);
+    scopes.pop_back();
+    return {scope, node};
+}
+
+int Analyzer::localSlot(SymbolId name) const {
+    return scopes.empty() ? -1 : scopes.back()->slotOf(name);
+}
@@ -0,0 +1,93 @@
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "./gc.h"
+#include "./value.h"
+
+// Call to a lambda left in tail position by a node, to be applied by the
+// loop in EvalEnv::apply instead of on a deeper C++ frame.
+struct TailCall {
+    ValuePtr proc;
+    std::vector<ValuePtr> args;
+    bool pending{false};
+};
+
+struct Bytecode;
+
+// Executor of one analyzed expression: built once by the Analyzer, then run
+// any number of times without looking at the expression again. Values a
+// node holds on to are Pinned, so they live as long as the node.
+class Node {
+public:
+    virtual ~Node() = default;
+    // `tail` is null when the caller needs the value itself; otherwise a
+    // call to a lambda in tail position is left in it
+    virtual ValuePtr exec(EvalEnv& env, TailCall* tail = nullptr) const = 0;
+    // compiled form of the node, which the VM runs without calling exec
+    virtual const Bytecode* bytecode() const {
+        return nullptr;
+    }
+};
+
+using NodePtr = std::shared_ptr<const Node>;
+
+template <typename F>
+class ClosureNode : public Node {
+private:
+    F func;
+
+public:
+    explicit ClosureNode(F func) : func{std::move(func)} {}
+    ValuePtr exec(EvalEnv& env, TailCall* tail) const override {
+        return func(env, tail);
+    }
+};
+
+// node running `func(EvalEnv& env, TailCall* tail)`
+template <typename F>
+NodePtr makeNode(F func) {
+    return std::make_shared<ClosureNode<F>>(std::move(func));
+}
+
+// Turns expressions into node trees. Every reference to a variable bound by
+// an enclosing lambda, let or internal define is resolved to its frame
+// address (depth, slot); free variables are looked up by name at run time.
+// Analysis errors are deferred: the node of an ill-formed expression throws
+// them when it runs.
+class Analyzer {
+private:
+    std::vector<const ScopeValue*> scopes;  // innermost last
+
+    NodePtr analyzeExpr(const ValuePtr& expr);
+    NodePtr analyzeVariable(SymbolId name) const;
+    NodePtr analyzeApplication(const ValuePtr& head, const ValuePtr& operands);
+
+public:
+    Analyzer() = default;
+    // analyzer for code running in the innermost of `scopes`
+    explicit Analyzer(std::vector<const ScopeValue*> scopes)
+        : scopes{std::move(scopes)} {}
+
+    static NodePtr constant(ValuePtr val);
+    // ScopeValue of a frame binding `params` followed by the internal
+    // defines of `body` that always run (see collectDefines)
+    static ValuePtr makeScope(const std::vector<SymbolId>& params,
+                              const std::vector<ValuePtr>& body);
+
+    NodePtr analyze(const ValuePtr& expr);
+    // non-empty `exprs` run in order, the last one in tail position
+    NodePtr analyzeSequence(const std::vector<ValuePtr>& exprs);
+    // Analyzes `body` in a new frame of makeScope(params, body); returns
+    // that frame's ScopeValue and the body node.
+    std::pair<ValuePtr, NodePtr> analyzeScope(
+        const std::vector<SymbolId>& params,
+        const std::vector<ValuePtr>& body);
+    // slot of `name` in the innermost frame, or -1 if it is not bound there
+    int localSlot(SymbolId name) const;
+};
+
+#endif
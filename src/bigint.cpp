@@ -0,0 +1,333 @@
+#include "./bigint.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+BigInt::BigInt(Limbs limbs, bool negative)
+    : limbs{std::move(limbs)}, negative{negative} {
+    trim(this->limbs);
+    if (this->limbs.empty()) this->negative = false;  // a single 0
+}
+
+BigInt::BigInt(std::int64_t value) : negative{value < 0} {
+    // negated as unsigned, which also holds the magnitude of INT64_MIN
+    auto magnitude = static_cast<std::uint64_t>(value);
+    if (negative) magnitude = ~magnitude + 1;
+    for (; magnitude != 0; magnitude /= BASE)
+        limbs.push_back(static_cast<std::uint32_t>(magnitude % BASE));
+}
+
+void BigInt::trim(Limbs& limbs) {
+    while (!limbs.empty() && limbs.back() == 0) limbs.pop_back();
+}
+
+bool BigInt::isDecimal(std::string_view text) {
+    if (text.starts_with('+') || text.starts_with('-')) text.remove_prefix(1);
+    return !text.empty() && std::ranges::all_of(text, [](char c) {
+        return std::isdigit(static_cast<unsigned char>(c));
+    });
+}
+
+std::optional<BigInt> BigInt::parse(std::string_view text) {
+    if (!isDecimal(text)) return std::nullopt;
+    bool negative = text.front() == '-';
+    if (text.front() == '+' || text.front() == '-') text.remove_prefix(1);
+
+    // a limb for every 9 digits, from the least significant
+    Limbs limbs;
+    limbs.reserve(text.size() / BASE_DIGITS + 1);
+    for (auto end = text.size(); end != 0;) {
+        auto begin = end > BASE_DIGITS ? end - BASE_DIGITS : 0;
+        std::uint32_t limb = 0;
+        for (auto i = begin; i != end; ++i) limb = limb * 10 + (text[i] - '0');
+        limbs.push_back(limb);
+        end = begin;
+    }
+    return BigInt(std::move(limbs), negative);
+}
+
+std::optional<std::int64_t> BigInt::toInt64() const {
+    constexpr auto MAX = std::numeric_limits<std::uint64_t>::max();
+    std::uint64_t magnitude = 0;
+    for (auto it = limbs.rbegin(); it != limbs.rend(); ++it) {
+        if (magnitude > (MAX - *it) / BASE) return std::nullopt;
+        magnitude = magnitude * BASE + *it;
+    }
+    constexpr auto LIMIT = std::uint64_t{1} << 63;  // magnitude of INT64_MIN
+    if (magnitude > LIMIT - (negative ? 0 : 1)) return std::nullopt;
+    return negative ? static_cast<std::int64_t>(~magnitude + 1)
+                    : static_cast<std::int64_t>(magnitude);
+}
+
+double BigInt::toDouble() const {
+    double value = 0;
+    for (auto it = limbs.rbegin(); it != limbs.rend(); ++it)
+        value = value * BASE + *it;
+    return negative ? -value : value;
+}
+
+std::size_t BigInt::powerStorageSize(std::uint64_t exponent) const {
+    // 0 and 1 stay as they are
+    if (exponent == 0 || limbs.empty() ||
+        (limbs.size() == 1 && limbs[0] == 1))
+        return sizeof(std::uint32_t);
+    // decimal digits of the magnitude, rounded up from its top limb
+    double digits = static_cast<double>(limbs.size() - 1) * BASE_DIGITS +
+                    std::log10(limbs.back() + 1.0);
+    double bytes = (digits * static_cast<double>(exponent) / BASE_DIGITS + 1) *
+                   sizeof(std::uint32_t);
+    return bytes < static_cast<double>(SIZE_MAX)
+               ? static_cast<std::size_t>(bytes)
+               : SIZE_MAX;
+}
+
+std::string BigInt::toString() const {
+    if (limbs.empty()) return "0";
+    char digits[BASE_DIGITS];
+    auto end = std::to_chars(digits, digits + BASE_DIGITS, limbs.back()).ptr;
+    std::string res = negative ? "-" : "";
+    res.append(digits, end);
+
+    // the other limbs take 9 digits each, zero-padded on the left
+    auto pos = res.size();
+    res.resize(pos + (limbs.size() - 1) * BASE_DIGITS, '0');
+    for (auto it = limbs.rbegin() + 1; it != limbs.rend(); ++it) {
+        pos += BASE_DIGITS;
+        end = std::to_chars(digits, digits + BASE_DIGITS, *it).ptr;
+        std::copy(digits, end, res.data() + pos - (end - digits));
+    }
+    return res;
+}
+
+int BigInt::compareMagnitudes(const Limbs& lhs, const Limbs& rhs) {
+    if (lhs.size() != rhs.size()) return lhs.size() < rhs.size() ? -1 : 1;
+    for (auto i = lhs.size(); i-- != 0;)
+        if (lhs[i] != rhs[i]) return lhs[i] < rhs[i] ? -1 : 1;
+    return 0;
+}
+
+BigInt::Limbs BigInt::addMagnitudes(const Limbs& lhs, const Limbs& rhs) {
+    Limbs sum{lhs};
+    addShifted(sum, rhs, 0);
+    return sum;
+}
+
+BigInt::Limbs BigInt::subtractMagnitudes(const Limbs& lhs, const Limbs& rhs) {
+    Limbs diff{lhs};
+    std::int64_t borrow = 0;
+    for (std::size_t i = 0; i != diff.size(); ++i) {
+        std::int64_t limb = diff[i] - borrow - (i < rhs.size() ? rhs[i] : 0);
+        borrow = limb < 0;
+        diff[i] = static_cast<std::uint32_t>(limb + (borrow ? BASE : 0));
+        if (i >= rhs.size() && !borrow) break;
+    }
+    trim(diff);
+    return diff;
+}
+
+void BigInt::addShifted(Limbs& sum, const Limbs& addend, std::size_t shift) {
+    if (sum.size() < addend.size() + shift) sum.resize(addend.size() + shift);
+    std::uint32_t carry = 0;
+    for (std::size_t i = 0; i < addend.size() || carry != 0; ++i) {
+        if (shift + i == sum.size()) sum.push_back(0);
+        std::uint32_t limb = sum[shift + i] + carry +
+                             (i < addend.size() ? addend[i] : 0);
+        carry = limb >= BASE;
+        sum[shift + i] = carry ? limb - BASE : limb;
+    }
+    trim(sum);
+}
+
+BigInt::Limbs BigInt::multiplyMagnitudes(const Limbs& lhs, const Limbs& rhs) {
+    if (lhs.empty() || rhs.empty()) return {};
+    if (std::min(lhs.size(), rhs.size()) < KARATSUBA_MIN)
+        return schoolbook(lhs, rhs);
+    return lhs.size() >= rhs.size() ? karatsuba(lhs, rhs)
+                                    : karatsuba(rhs, lhs);
+}
+
+BigInt::Limbs BigInt::schoolbook(const Limbs& lhs, const Limbs& rhs) {
+    Limbs product(lhs.size() + rhs.size());
+    for (std::size_t i = 0; i != lhs.size(); ++i) {
+        // below BASE^2 + BASE, far from overflowing
+        std::uint64_t carry = 0;
+        for (std::size_t j = 0; j != rhs.size(); ++j) {
+            auto cur = product[i + j] + std::uint64_t{lhs[i]} * rhs[j] + carry;
+            product[i + j] = static_cast<std::uint32_t>(cur % BASE);
+            carry = cur / BASE;
+        }
+        product[i + rhs.size()] = static_cast<std::uint32_t>(carry);
+    }
+    trim(product);
+    return product;
+}
+
+BigInt::Limbs BigInt::karatsuba(const Limbs& lhs, const Limbs& rhs) {
+    // lhs is the longer, split in halves of `half` limbs
+    auto half = (lhs.size() + 1) / 2;
+    auto low = [half](const Limbs& limbs) {
+        Limbs res(limbs.begin(), limbs.begin() + std::min(half, limbs.size()));
+        trim(res);
+        return res;
+    };
+    auto high = [half](const Limbs& limbs) {
+        return limbs.size() > half ? Limbs(limbs.begin() + half, limbs.end())
+                                   : Limbs{};
+    };
+    auto lhs0 = low(lhs), lhs1 = high(lhs);
+    if (rhs.size() <= half) {
+        // too short to split: lhs1 * rhs * BASE^half + lhs0 * rhs
+        auto product = multiplyMagnitudes(lhs0, rhs);
+        addShifted(product, multiplyMagnitudes(lhs1, rhs), half);
+        return product;
+    }
+
+    auto rhs0 = low(rhs), rhs1 = high(rhs);
+    auto z0 = multiplyMagnitudes(lhs0, rhs0);
+    auto z2 = multiplyMagnitudes(lhs1, rhs1);
+    // (lhs0 + lhs1)(rhs0 + rhs1) - z0 - z2 = lhs0 * rhs1 + lhs1 * rhs0
+    auto z1 = multiplyMagnitudes(addMagnitudes(lhs0, lhs1),
+                                 addMagnitudes(rhs0, rhs1));
+    z1 = subtractMagnitudes(subtractMagnitudes(z1, z0), z2);
+
+    auto product = std::move(z0);
+    addShifted(product, z1, half);
+    addShifted(product, z2, 2 * half);
+    return product;
+}
+
+std::pair<BigInt::Limbs, BigInt::Limbs> BigInt::divModMagnitudes(
+    const Limbs& dividend, const Limbs& divisor) {
+    if (compareMagnitudes(dividend, divisor) < 0) return {{}, dividend};
+
+    Limbs quotient(dividend.size());
+    if (divisor.size() == 1) {
+        std::uint64_t rem = 0;
+        for (auto i = dividend.size(); i-- != 0;) {
+            auto cur = rem * BASE + dividend[i];
+            quotient[i] = static_cast<std::uint32_t>(cur / divisor[0]);
+            rem = cur % divisor[0];
+        }
+        trim(quotient);
+        Limbs remainder{static_cast<std::uint32_t>(rem)};
+        trim(remainder);
+        return {quotient, remainder};
+    }
+
+    // Knuth's algorithm D: scaling both operands so the top limb of the
+    // divisor is at least BASE / 2 makes each estimated quotient limb at
+    // most one too large
+    auto scale = [](const Limbs& limbs, std::uint32_t factor) {
+        Limbs res(limbs.size() + 1);
+        std::uint64_t carry = 0;
+        for (std::size_t i = 0; i != limbs.size(); ++i) {
+            auto cur = std::uint64_t{limbs[i]} * factor + carry;
+            res[i] = static_cast<std::uint32_t>(cur % BASE);
+            carry = cur / BASE;
+        }
+        res.back() = static_cast<std::uint32_t>(carry);
+        return res;
+    };
+    auto n = divisor.size(), m = dividend.size() - n;
+    auto factor = BASE / (divisor.back() + 1);
+    auto u = scale(dividend, factor);
+    auto v = scale(divisor, factor);
+    v.pop_back();  // the scaled divisor still has n limbs
+
+    for (auto j = m + 1; j-- != 0;) {
+        auto num = std::uint64_t{u[j + n]} * BASE + u[j + n - 1];
+        auto qhat = num / v[n - 1], rhat = num % v[n - 1];
+        while (qhat >= BASE ||
+               qhat * v[n - 2] > rhat * BASE + u[j + n - 2]) {
+            --qhat;
+            rhat += v[n - 1];
+            if (rhat >= BASE) break;
+        }
+
+        // u[j .. j + n] -= qhat * v
+        std::uint64_t carry = 0;
+        std::int64_t borrow = 0;
+        for (std::size_t i = 0; i != n; ++i) {
+            auto product = qhat * v[i] + carry;
+            carry = product / BASE;
+            std::int64_t limb = std::int64_t{u[i + j]} -
+                                static_cast<std::int64_t>(product % BASE) -
+                                borrow;
+            borrow = limb < 0;
+            u[i + j] = static_cast<std::uint32_t>(limb + (borrow ? BASE : 0));
+        }
+        if (std::int64_t{u[j + n]} - static_cast<std::int64_t>(carry) -
+                borrow <
+            0) {
+            // qhat was one too large: add v back
+            --qhat;
+            std::uint32_t add_carry = 0;
+            for (std::size_t i = 0; i != n; ++i) {
+                std::uint32_t limb = u[i + j] + v[i] + add_carry;
+                add_carry = limb >= BASE;
+                u[i + j] = add_carry ? limb - BASE : limb;
+            }
+        }
+        // what is left of u[j .. j + n] is below v, so its top limb is 0
+        u[j + n] = 0;
+        quotient[j] = static_cast<std::uint32_t>(qhat);
+    }
+
+    // the remainder, scaled back
+    Limbs remainder(n);
+    std::uint64_t rem = 0;
+    for (auto i = n; i-- != 0;) {
+        auto cur = rem * BASE + u[i];
+        remainder[i] = static_cast<std::uint32_t>(cur / factor);
+        rem = cur % factor;
+    }
+    trim(quotient);
+    trim(remainder);
+    return {quotient, remainder};
+}
+
+BigInt BigInt::operator-() const {
+    return BigInt(limbs, !negative);
+}
+
+BigInt operator+(const BigInt& lhs, const BigInt& rhs) {
+    if (lhs.negative == rhs.negative)
+        return BigInt(BigInt::addMagnitudes(lhs.limbs, rhs.limbs),
+                      lhs.negative);
+    // the sign of the larger magnitude
+    if (BigInt::compareMagnitudes(lhs.limbs, rhs.limbs) >= 0)
+        return BigInt(BigInt::subtractMagnitudes(lhs.limbs, rhs.limbs),
+                      lhs.negative);
+    return BigInt(BigInt::subtractMagnitudes(rhs.limbs, lhs.limbs),
+                  rhs.negative);
+}
+
+BigInt operator-(const BigInt& lhs, const BigInt& rhs) {
+    return lhs + -rhs;
+}
+
+BigInt operator*(const BigInt& lhs, const BigInt& rhs) {
+    return BigInt(BigInt::multiplyMagnitudes(lhs.limbs, rhs.limbs),
+                  lhs.negative != rhs.negative);
+}
+
+std::pair<BigInt, BigInt> BigInt::divMod(const BigInt& dividend,
+                                         const BigInt& divisor) {
+    auto [quotient, remainder] =
+        divModMagnitudes(dividend.limbs, divisor.limbs);
+    return {BigInt(std::move(quotient), dividend.negative != divisor.negative),
+            BigInt(std::move(remainder), dividend.negative)};
+}
+
+std::strong_ordering operator<=>(const BigInt& lhs, const BigInt& rhs) {
+    if (lhs.negative != rhs.negative)
+        return lhs.negative ? std::strong_ordering::less
+                            : std::strong_ordering::greater;
+    auto cmp = BigInt::compareMagnitudes(lhs.limbs, rhs.limbs);
+    if (lhs.negative) cmp = -cmp;
+    return cmp <=> 0;
+}
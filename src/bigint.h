@@ -0,0 +1,85 @@
+#ifndef BIGINT_H
+#define BIGINT_H
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Arbitrary-precision integer, as a sign and a magnitude. The magnitude is
+// held in base 10^9 limbs, least significant first, so reading and printing
+// decimals take linear time. Large products are computed by Karatsuba
+// multiplication, quotients by long division.
+class BigInt {
+private:
+    using Limbs = std::vector<std::uint32_t>;
+    static constexpr std::uint32_t BASE = 1'000'000'000;
+    static constexpr int BASE_DIGITS = 9;
+    // operands shorter than this are multiplied the schoolbook way
+    static constexpr std::size_t KARATSUBA_MIN = 32;
+
+    Limbs limbs;  // without leading zeros, so 0 has none
+    bool negative{false};
+
+    BigInt(Limbs limbs, bool negative);
+
+    static void trim(Limbs& limbs);
+    static int compareMagnitudes(const Limbs& lhs, const Limbs& rhs);
+    static Limbs addMagnitudes(const Limbs& lhs, const Limbs& rhs);
+    // lhs - rhs, for lhs >= rhs
+    static Limbs subtractMagnitudes(const Limbs& lhs, const Limbs& rhs);
+    // adds `addend` * BASE^shift to `sum`
+    static void addShifted(Limbs& sum, const Limbs& addend, std::size_t shift);
+    static Limbs multiplyMagnitudes(const Limbs& lhs, const Limbs& rhs);
+    static Limbs schoolbook(const Limbs& lhs, const Limbs& rhs);
+    static Limbs karatsuba(const Limbs& lhs, const Limbs& rhs);
+    static std::pair<Limbs, Limbs> divModMagnitudes(const Limbs& dividend,
+                                                    const Limbs& divisor);
+
+public:
+    BigInt() = default;
+    BigInt(std::int64_t value);
+
+    // decimal digits with an optional sign
+    static bool isDecimal(std::string_view text);
+    static std::optional<BigInt> parse(std::string_view text);
+
+    bool isZero() const {
+        return limbs.empty();
+    }
+    bool isNegative() const {
+        return negative;
+    }
+    bool isOdd() const {
+        return !limbs.empty() && limbs.front() % 2 != 0;  // BASE is even
+    }
+    // bytes the magnitude takes outside the object
+    std::size_t storageSize() const {
+        return limbs.size() * sizeof(std::uint32_t);
+    }
+    // bytes the magnitude of this to the power `exponent` takes, at most,
+    // or SIZE_MAX if they do not fit a size_t
+    std::size_t powerStorageSize(std::uint64_t exponent) const;
+    std::optional<std::int64_t> toInt64() const;
+    double toDouble() const;
+    std::string toString() const;
+
+    BigInt operator-() const;
+    friend BigInt operator+(const BigInt& lhs, const BigInt& rhs);
+    friend BigInt operator-(const BigInt& lhs, const BigInt& rhs);
+    friend BigInt operator*(const BigInt& lhs, const BigInt& rhs);
+    // truncated quotient, and remainder of the sign of the dividend; the
+    // divisor must not be 0
+    static std::pair<BigInt, BigInt> divMod(const BigInt& dividend,
+                                            const BigInt& divisor);
+
+    friend bool operator==(const BigInt& lhs, const BigInt& rhs) = default;
+    friend std::strong_ordering operator<=>(const BigInt& lhs,
+                                            const BigInt& rhs);
+};
+
+#endif
@@ -1,20 +1,40 @@
 #include "./boot.h"
 
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 
 #include "./error.h"
 #include "./eval_env.h"
+#include "./gc.h"
 #include "./parser.h"
 #include "./reader.h"
 #include "./tokenizer.h"
 #include "./value.h"
+#include "./vm.h"
+
+namespace {
+bool vm_mode = false;
+}
+
+void setVMMode(bool enabled) {
+    vm_mode = enabled;
+}
+
+void setMaxHeap(std::size_t bytes) {
+    Heap::instance().setLimit(bytes);
+}
 
 ValuePtr evaluate(std::string expr) {
-    auto tokens = Tokenizer::tokenize(expr);
-    Parser parser(std::move(tokens));
+    // nothing is held between top-level forms, e.g. after a form failed
+    // for lack of memory
+    Heap::instance().safepoint();
+    TokenList tokens;
+    Tokenizer::tokenize(expr, tokens);
+    Parser parser(tokens);
     auto value = parser.parse();
     static auto env = EvalEnv::createGlobal();
+    if (vm_mode) return VM::eval(value, env);
     return env->eval(std::move(value));
 }
 
@@ -22,8 +42,9 @@ ValuePtr readParse(std::istream& is) {
     Reader reader(is);
     std::string expr = reader.read();
     if (reader.fail()) std::exit(0);
-    auto tokens = Tokenizer::tokenize(expr);
-    Parser parser(std::move(tokens));
+    TokenList tokens;
+    Tokenizer::tokenize(expr, tokens);
+    Parser parser(tokens);
     return parser.parse();
 }
 
@@ -34,7 +55,7 @@ void REPLMode() {
             std::string expr = reader.read();
             if (reader.fail()) std::exit(0);
             auto result = evaluate(expr);
-            std::cout << result->toString() << std::endl;
+            std::cout << result.toString() << std::endl;
         } catch (Error& e) {
             e.handle();
         }
@@ -53,7 +74,7 @@ void fileMode(const std::string& file) {
             Reader reader(src, &line_num);
             std::string expr = reader.read();
             if (reader.fail()) break;
-            auto result = evaluate(expr);
+            evaluate(expr);
         } catch (Error& e) {
             std::cerr << "Error occurred in " + file + " line " +
                              std::to_string(line_num)
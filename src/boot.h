@@ -1,9 +1,16 @@
 #ifndef BOOST_H
 #define BOOST_H
 
+#include <cstddef>
 #include <string>
 #include "./value.h"
 
+// run top-level forms on the bytecode VM instead of the tree walker
+void setVMMode(bool enabled);
+// limit the heap to about `bytes`, 0 for no limit: allocating beyond it
+// raises an error
+void setMaxHeap(std::size_t bytes);
+ValuePtr evaluate(std::string expr);
 ValuePtr readParse(std::istream&);
 void REPLMode();
 void fileMode(const std::string&);
@@ -1,6 +1,8 @@
 #include "./builtins.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iomanip>
 #include <iostream>
 #include <numeric>
@@ -8,652 +10,910 @@
 
 #include "./error.h"
 #include "./eval_env.h"
+#include "./gc.h"
+#include "./simd.h"
 
 namespace ranges = std::ranges;
 
-// helper functions
-void Builtins::checkArgNum(const std::vector<ValuePtr>& params, std::size_t min,
-                           std::size_t max) {
-    if (params.size() > max)
-        throw LispError("Too many arguments: " + std::to_string(params.size()) +
-                        " > " + std::to_string(max));
-    if (params.size() < min)
-        throw LispError("Too few arguments: " + std::to_string(params.size()) +
-                        " < " + std::to_string(min));
+namespace {
+// Exact integers are fixnums, computed on natively, or BigInts beyond the
+// fixnum range: fixnums are 48 bits wide, so sums and differences cannot
+// overflow an int64_t, and fromInteger()/fromBigInt() pick the kind of the
+// result. Any double operand makes the result a double.
+bool bothFixnums(const ValuePtr& lhs, const ValuePtr& rhs) {
+    return lhs.isFixnum() && rhs.isFixnum();
 }
 
-std::vector<ValuePtr> Builtins::vectorize(const ValuePtr& ls) {
-    if (!Value::isList(ls))
-        throw LispError("Malformed list: " + ls->toString());
-    return ls->toVector();
+bool bothExact(const ValuePtr& lhs, const ValuePtr& rhs) {
+    return lhs.isExactInteger() && rhs.isExactInteger();
 }
 
-std::vector<double> Builtins::numericalize(const std::vector<ValuePtr>& vals) {
-    std::vector<double> nums;
-    for (auto& val : vals) {
-        double num = val->asNumber();
-        nums.push_back(num);
-    }
-    return nums;
+BigInt toBigInt(const ValuePtr& num) {
+    if (num.isFixnum()) return BigInt(num.fixnum());
+    return num.cast<BigIntValue>()->getVal();
 }
 
-// calc
+// bytes of the magnitude of an exact integer, as a BigInt
+std::size_t storageSize(const ValuePtr& num) {
+    if (auto big = num.cast<BigIntValue>()) return big->getVal().storageSize();
+    return sizeof(std::int64_t);
+}
 
-ValuePtr Builtins::add(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    double total{0};
-    auto nums = numericalize(params);
-    for (auto num : nums) {
-        total += num;
-    }
-    return std::make_shared<NumericValue>(total);
+ValuePtr addNumbers(const ValuePtr& lhs, const ValuePtr& rhs) {
+    if (bothFixnums(lhs, rhs))
+        return ValuePtr::fromInteger(lhs.fixnum() + rhs.fixnum());
+    if (bothExact(lhs, rhs))
+        return ValuePtr::fromBigInt(toBigInt(lhs) + toBigInt(rhs));
+    return ValuePtr::fromNumber(lhs.asNumber() + rhs.asNumber());
 }
 
-ValuePtr Builtins::subtract(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 2);
+ValuePtr subtractNumbers(const ValuePtr& lhs, const ValuePtr& rhs) {
+    if (bothFixnums(lhs, rhs))
+        return ValuePtr::fromInteger(lhs.fixnum() - rhs.fixnum());
+    if (bothExact(lhs, rhs))
+        return ValuePtr::fromBigInt(toBigInt(lhs) - toBigInt(rhs));
+    return ValuePtr::fromNumber(lhs.asNumber() - rhs.asNumber());
+}
 
-    double minuend = 0;
-    double subtrahend = 0;
-    auto nums = numericalize(params);
-    if (nums.size() == 1)
-        subtrahend = nums[0];
-    else {
-        minuend = nums[0];
-        subtrahend = nums[1];
+ValuePtr multiplyNumbers(const ValuePtr& lhs, const ValuePtr& rhs) {
+    if (bothFixnums(lhs, rhs)) {
+        auto a = lhs.fixnum(), b = rhs.fixnum();
+        // the product fits an int64_t when it is still a fixnum
+        if (a == 0 || std::abs(b) <= ValuePtr::FIXNUM_MAX / std::abs(a))
+            return ValuePtr::fromInteger(a * b);
     }
-    return std::make_shared<NumericValue>(minuend - subtrahend);
+    if (bothExact(lhs, rhs)) {
+        // the product has at most the limbs of both operands together
+        Heap::instance().reserve(storageSize(lhs) + storageSize(rhs));
+        return ValuePtr::fromBigInt(toBigInt(lhs) * toBigInt(rhs));
+    }
+    return ValuePtr::fromNumber(lhs.asNumber() * rhs.asNumber());
 }
 
-ValuePtr Builtins::multiply(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    double total{1};
-    auto nums = numericalize(params);
-    for (auto num : nums) {
-        total *= num;
-    }
-    return std::make_shared<NumericValue>(total);
+// truncated quotient and remainder of exact integers, the divisor nonzero
+std::pair<ValuePtr, ValuePtr> divModNumbers(const ValuePtr& lhs,
+                                            const ValuePtr& rhs) {
+    if (bothFixnums(lhs, rhs))
+        return {ValuePtr::fromInteger(lhs.fixnum() / rhs.fixnum()),
+                ValuePtr::fromInteger(lhs.fixnum() % rhs.fixnum())};
+    auto [quotient, remainder] = BigInt::divMod(toBigInt(lhs), toBigInt(rhs));
+    return {ValuePtr::fromBigInt(std::move(quotient)),
+            ValuePtr::fromBigInt(std::move(remainder))};
 }
 
-ValuePtr Builtins::divide(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 2);
+bool isExactDivisor(const ValuePtr& dividend, const ValuePtr& divisor) {
+    // bignums are never 0
+    return bothExact(dividend, divisor) &&
+           !(divisor.isFixnum() && divisor.fixnum() == 0);
+}
 
-    double dividend = 1;
-    double divisor = 1;
-    auto nums = numericalize(params);
-    if (nums.size() == 1)
-        divisor = nums[0];
-    else {
-        dividend = nums[0];
-        divisor = nums[1];
+bool isNegative(const ValuePtr& num) {
+    if (num.isFixnum()) return num.fixnum() < 0;
+    if (auto big = num.cast<BigIntValue>()) return big->getVal().isNegative();
+    return num.asNumber() < 0;
+}
+
+// <0, 0 or >0 as lhs is less than, equal to or greater than rhs
+int compareNumbers(const ValuePtr& lhs, const ValuePtr& rhs) {
+    if (bothFixnums(lhs, rhs))
+        return (lhs.fixnum() > rhs.fixnum()) - (lhs.fixnum() < rhs.fixnum());
+    if (bothExact(lhs, rhs)) {
+        auto cmp = toBigInt(lhs) <=> toBigInt(rhs);
+        return (cmp > 0) - (cmp < 0);
     }
-    return std::make_shared<NumericValue>(dividend / divisor);
+    double a = lhs.asNumber(), b = rhs.asNumber();
+    return (a > b) - (a < b);
 }
 
-ValuePtr Builtins::abs(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
+// `val` as a length or an index, an exact integer >= 0
+std::size_t asSize(const ValuePtr& val) {
+    if (!val.isFixnum() || val.fixnum() < 0)
+        throw TypeError(val.toString() + " is not a valid index");
+    return static_cast<std::size_t>(val.fixnum());
+}
 
-    double num = params[0]->asNumber();
-    return std::make_shared<NumericValue>(std::abs(num));
+// `idx` as an index into `seq`, of `size` elements
+std::size_t checkIndex(const ValuePtr& seq, std::size_t size,
+                       const ValuePtr& idx) {
+    auto i = asSize(idx);
+    if (i >= size)
+        throw LispError("Index " + idx.toString() + " is out of bound of " +
+                        seq.toString());
+    return i;
 }
 
-ValuePtr Builtins::expt(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+VectorValue* asVector(const ValuePtr& val) {
+    if (auto vec = val.cast<VectorValue>()) return vec;
+    throw TypeError(val.toString() + " is not a vector");
+}
+
+std::span<double> asF64Vector(const ValuePtr& val) {
+    if (auto vec = val.cast<F64VectorValue>()) return vec->getVal();
+    throw TypeError(val.toString() + " is not an f64vector");
+}
 
-    auto nums = numericalize(params);
-    return std::make_shared<NumericValue>(std::pow(nums[0], nums[1]));
+void checkSameLength(std::span<double> xs, std::span<double> ys) {
+    if (xs.size() != ys.size())
+        throw LispError("F64vectors of different lengths: " +
+                        std::to_string(xs.size()) + " and " +
+                        std::to_string(ys.size()));
+}
+}  // namespace
+
+// helper functions
+void Builtins::checkArgNum(std::span<const ValuePtr> params, std::size_t min,
+                           std::size_t max) {
+    if (params.size() > max)
+        throw LispError("Too many arguments: " + std::to_string(params.size()) +
+                        " > " + std::to_string(max));
+    if (params.size() < min)
+        throw LispError("Too few arguments: " + std::to_string(params.size()) +
+                        " < " + std::to_string(min));
 }
 
-ValuePtr Builtins::quotient(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+void Builtins::checkList(const ValuePtr& ls) {
+    if (!Value::isList(ls))
+        throw LispError("Malformed list: " + ls.toString());
+}
 
-    auto nums = numericalize(params);
-    return std::make_shared<NumericValue>(std::trunc(nums[0] / nums[1]));
+std::vector<ValuePtr> Builtins::vectorize(const ValuePtr& ls) {
+    checkList(ls);
+    return ls.toVector();
 }
 
-ValuePtr Builtins::remainder(const std::vector<ValuePtr>& params,
-                             EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+// calc
 
-    auto nums = numericalize(params);
-    double q = std::trunc(nums[0] / nums[1]);
-    return std::make_shared<NumericValue>(nums[0] - nums[1] * q);
+ValuePtr Builtins::add(std::span<const ValuePtr> params, EvalEnv& env) {
+    auto total = ValuePtr::fromInteger(0);
+    for (auto& param : params) total = addNumbers(total, param);
+    return total;
 }
 
-ValuePtr Builtins::modulo(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+ValuePtr Builtins::subtract(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (params.size() == 1)
+        return subtractNumbers(ValuePtr::fromInteger(0), params[0]);
+    return subtractNumbers(params[0], params[1]);
+}
 
-    auto nums = numericalize(params);
-    double q = std::trunc(nums[0] / nums[1]);
+ValuePtr Builtins::multiply(std::span<const ValuePtr> params, EvalEnv& env) {
+    auto total = ValuePtr::fromInteger(1);
+    for (auto& param : params) total = multiplyNumbers(total, param);
+    return total;
+}
+
+ValuePtr Builtins::divide(std::span<const ValuePtr> params, EvalEnv& env) {
+    auto dividend = ValuePtr::fromInteger(1);
+    auto divisor = params[0];
+    if (params.size() == 2) {
+        dividend = params[0];
+        divisor = params[1];
+    }
+    // exact only when the division is
+    if (isExactDivisor(dividend, divisor)) {
+        auto [quotient, remainder] = divModNumbers(dividend, divisor);
+        if (remainder.isFixnum() && remainder.fixnum() == 0) return quotient;
+    }
+    return ValuePtr::fromNumber(dividend.asNumber() / divisor.asNumber());
+}
+
+ValuePtr Builtins::abs(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (params[0].isExactInteger())
+        return isNegative(params[0])
+                   ? subtractNumbers(ValuePtr::fromInteger(0), params[0])
+                   : params[0];
+    double num = params[0].asNumber();
+    return ValuePtr::fromNumber(std::abs(num));
+}
+
+ValuePtr Builtins::expt(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (params[0].isExactInteger() && params[1].isFixnum() &&
+        params[1].fixnum() >= 0) {
+        // by squaring, once the result is known to fit
+        Heap::instance().reserve(
+            toBigInt(params[0]).powerStorageSize(params[1].fixnum()));
+        auto result = ValuePtr::fromInteger(1);
+        auto base = params[0];
+        for (auto exponent = params[1].fixnum(); exponent != 0;
+             exponent /= 2) {
+            if (exponent % 2 != 0) result = multiplyNumbers(result, base);
+            if (exponent != 1) base = multiplyNumbers(base, base);
+        }
+        return result;
+    }
+    double base = params[0].asNumber();
+    double exponent = params[1].asNumber();
+    return ValuePtr::fromNumber(std::pow(base, exponent));
+}
+
+ValuePtr Builtins::quotient(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (isExactDivisor(params[0], params[1]))
+        return divModNumbers(params[0], params[1]).first;
+    double dividend = params[0].asNumber();
+    double divisor = params[1].asNumber();
+    return ValuePtr::fromNumber(std::trunc(dividend / divisor));
+}
+
+ValuePtr Builtins::remainder(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (isExactDivisor(params[0], params[1]))
+        return divModNumbers(params[0], params[1]).second;
+    double dividend = params[0].asNumber();
+    double divisor = params[1].asNumber();
+    double q = std::trunc(dividend / divisor);
+    return ValuePtr::fromNumber(dividend - divisor * q);
+}
+
+ValuePtr Builtins::modulo(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (isExactDivisor(params[0], params[1])) {
+        auto rem = divModNumbers(params[0], params[1]).second;
+        // takes the sign of the divisor
+        if (!(rem.isFixnum() && rem.fixnum() == 0) &&
+            isNegative(rem) != isNegative(params[1]))
+            rem = addNumbers(rem, params[1]);
+        return rem;
+    }
+    double dividend = params[0].asNumber();
+    double divisor = params[1].asNumber();
+    double q = std::trunc(dividend / divisor);
     q = q < 0 ? q - 1 : q;
-    return std::make_shared<NumericValue>(nums[0] - nums[1] * q);
+    return ValuePtr::fromNumber(dividend - divisor * q);
 }
 
 // pair and list
 
-ValuePtr Builtins::car(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
-    if (auto pr = std::dynamic_pointer_cast<PairValue>(params[0]))
+ValuePtr Builtins::car(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (auto pr = params[0].cast<PairValue>())
         return pr->car();
     else
-        throw TypeError(params[0]->toString() + " is not a pair");
+        throw TypeError(params[0].toString() + " is not a pair");
 }
 
-ValuePtr Builtins::cdr(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
-    if (auto pr = std::dynamic_pointer_cast<PairValue>(params[0]))
+ValuePtr Builtins::cdr(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (auto pr = params[0].cast<PairValue>())
         return pr->cdr();
     else
-        throw TypeError(params[0]->toString() + " is not a pair");
+        throw TypeError(params[0].toString() + " is not a pair");
 }
 
-ValuePtr Builtins::cons(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
-
-    return std::make_shared<PairValue>(params[0], params[1]);
+ValuePtr Builtins::cons(std::span<const ValuePtr> params, EvalEnv& env) {
+    return Value::make<PairValue>(params[0], params[1]);
 }
 
-ValuePtr Builtins::length(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
-    auto vec = vectorize(params[0]);
-    return std::make_shared<NumericValue>(vec.size());
+ValuePtr Builtins::length(std::span<const ValuePtr> params, EvalEnv& env) {
+    checkList(params[0]);
+    return ValuePtr::fromInteger(ranges::distance(listElements(params[0])));
 }
 
-ValuePtr Builtins::list(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    return Value::makeList(params);
+ValuePtr Builtins::list(std::span<const ValuePtr> params, EvalEnv& env) {
+    ValuePtr list = ValuePtr::nil();
+    for (auto it = params.rbegin(); it != params.rend(); ++it)
+        list = Value::make<PairValue>(*it, list);
+    return list;
 }
 
-ValuePtr Builtins::append(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    std::vector<ValuePtr> appended;
-    for (auto& arg : params) {
-        auto vec = vectorize(arg);
-        ranges::copy(vec, std::back_inserter(appended));
-    }
-    return Value::makeList(appended);
+ValuePtr Builtins::append(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (params.empty()) return ValuePtr::nil();
+    for (auto& arg : params) checkList(arg);
+    // lists are immutable, so the last one is shared rather than copied
+    ListBuilder appended;
+    for (auto& arg : params.first(params.size() - 1))
+        for (auto val : listElements(arg)) appended.push(val);
+    return appended.finish(params.back());
 }
 
-ValuePtr Builtins::map(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
-
-    std::vector<ValuePtr> mapped;
+ValuePtr Builtins::map(std::span<const ValuePtr> params, EvalEnv& env) {
     if (!Value::isProcedure(params[0]))
-        throw TypeError(params[0]->toString() + " is not a procedure");
-    auto list = vectorize(params[1]);
+        throw TypeError(params[0].toString() + " is not a procedure");
+    if (auto vec = params[1].cast<F64VectorValue>()) {
+        // to an f64vector, so the results must be numbers
+        std::vector<double> mapped;
+        mapped.reserve(vec->getVal().size());
+        for (double x : vec->getVal()) {
+            auto arg = ValuePtr::fromNumber(x);
+            mapped.push_back(env.apply(params[0], {&arg, 1}).asNumber());
+        }
+        return Value::make<F64VectorValue>(std::move(mapped));
+    }
+    checkList(params[1]);
 
-    ranges::transform(
-        list.begin(), list.end(), std::back_inserter(mapped),
-        [&](ValuePtr arg) { return env.apply(params[0], {arg}); });
-    return Value::makeList(mapped);
+    ListBuilder mapped;
+    for (auto arg : listElements(params[1]))
+        mapped.push(env.apply(params[0], {&arg, 1}));
+    return mapped.finish();
 }
 
-ValuePtr Builtins::filter(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
-
-    std::vector<ValuePtr> filtered;
+ValuePtr Builtins::filter(std::span<const ValuePtr> params, EvalEnv& env) {
     if (!Value::isProcedure(params[0]))
-        throw TypeError(params[0]->toString() + " is not a procedure");
-    auto list = vectorize(params[1]);
+        throw TypeError(params[0].toString() + " is not a procedure");
+    if (auto vec = params[1].cast<F64VectorValue>()) {
+        std::vector<double> filtered;
+        for (double x : vec->getVal()) {
+            auto arg = ValuePtr::fromNumber(x);
+            if (!Value::isVirtual(env.apply(params[0], {&arg, 1})))
+                filtered.push_back(x);
+        }
+        return Value::make<F64VectorValue>(std::move(filtered));
+    }
+    checkList(params[1]);
 
-    ranges::copy_if(list.begin(), list.end(), std::back_inserter(filtered),
-                    [&](ValuePtr val) {
-                        return !Value::isVirtual(env.apply(params[0], {val}));
-                    });
-    return Value::makeList(filtered);
+    ListBuilder filtered;
+    for (auto arg : listElements(params[1]))
+        if (!Value::isVirtual(env.apply(params[0], {&arg, 1})))
+            filtered.push(arg);
+    return filtered.finish();
 }
 
-ValuePtr Builtins::reduce(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
-
-    std::vector<ValuePtr> reduced;
+ValuePtr Builtins::reduce(std::span<const ValuePtr> params, EvalEnv& env) {
     if (!Value::isProcedure(params[0]))
-        throw TypeError(params[0]->toString() + " is not a procedure");
-    auto list = vectorize(params[1]);
+        throw TypeError(params[0].toString() + " is not a procedure");
+    auto combine = [&](ValuePtr result, ValuePtr next) {
+        // the running result is not in the sequence
+        ArgBuffer args;
+        args.push(result);
+        args.push(next);
+        return env.apply(params[0], args.args());
+    };
+
+    if (auto vec = params[1].cast<F64VectorValue>()) {
+        auto xs = vec->getVal();
+        if (xs.empty()) throw LispError("Cannot reduce an empty f64vector");
+        auto result = ValuePtr::fromNumber(xs[0]);
+        for (double x : xs.subspan(1))
+            result = combine(result, ValuePtr::fromNumber(x));
+        return result;
+    }
+    checkList(params[1]);
+    auto it = ListIterator(params[1]);
+    if (it == std::default_sentinel)
+        throw LispError("Cannot reduce an empty list");
 
-    return std::accumulate(list.begin() + 1, list.end(), list.front(),
-                           [&](ValuePtr arg0, ValuePtr arg1) {
-                               return env.apply(params[0], {arg0, arg1});
-                           });
+    auto result = *it++;
+    for (; it != std::default_sentinel; ++it) result = combine(result, *it);
+    return result;
 }
 
 // type
 
-ValuePtr Builtins::isAtom(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
-    return std::make_shared<BooleanValue>(!Value::isPair(params[0]) &&
-                                          !Value::isProcedure(params[0]));
+ValuePtr Builtins::isAtom(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(!Value::isPair(params[0]) &&
+                              !Value::isProcedure(params[0]));
 }
 
-ValuePtr Builtins::isBoolean(const std::vector<ValuePtr>& params,
-                             EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
-    return std::make_shared<BooleanValue>(Value::isBoolean(params[0]));
+ValuePtr Builtins::isBoolean(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(Value::isBoolean(params[0]));
 }
 
-ValuePtr Builtins::isInteger(const std::vector<ValuePtr>& params,
-                             EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
+ValuePtr Builtins::isInteger(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (params[0].isExactInteger()) return ValuePtr::fromBool(true);
     if (Value::isNumeric(params[0]))
-        return std::make_shared<BooleanValue>(
-            fmod(params[0]->asNumber(), 1.0) == 0.0);
+        return ValuePtr::fromBool(fmod(params[0].asNumber(), 1.0) == 0.0);
 
-    return std::make_shared<BooleanValue>(false);
+    return ValuePtr::fromBool(false);
 }
 
-ValuePtr Builtins::isList(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
-    return std::make_shared<BooleanValue>(Value::isList(params[0]));
+ValuePtr Builtins::isList(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(Value::isList(params[0]));
 }
 
-ValuePtr Builtins::isNumber(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
-    return std::make_shared<BooleanValue>(Value::isNumeric(params[0]));
+ValuePtr Builtins::isNumber(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(Value::isNumeric(params[0]));
 }
 
-ValuePtr Builtins::isNull(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
-    return std::make_shared<BooleanValue>(Value::isNil(params[0]));
+ValuePtr Builtins::isNull(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(Value::isNil(params[0]));
 }
 
-ValuePtr Builtins::isPair(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
-    return std::make_shared<BooleanValue>(Value::isPair(params[0]));
+ValuePtr Builtins::isPair(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(Value::isPair(params[0]));
 }
 
-ValuePtr Builtins::isProcedure(const std::vector<ValuePtr>& params,
-                               EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
-    return std::make_shared<BooleanValue>(Value::isProcedure(params[0]));
+ValuePtr Builtins::isProcedure(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(Value::isProcedure(params[0]));
 }
 
-ValuePtr Builtins::isString(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
-    return std::make_shared<BooleanValue>(Value::isString(params[0]));
+ValuePtr Builtins::isString(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(Value::isString(params[0]));
 }
 
-ValuePtr Builtins::isSymbol(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1);
-
-    return std::make_shared<BooleanValue>(Value::isSymbol(params[0]));
+ValuePtr Builtins::isSymbol(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(Value::isSymbol(params[0]));
 }
 
 // core
 
-ValuePtr Builtins::apply(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
-
+ValuePtr Builtins::apply(std::span<const ValuePtr> params, EvalEnv& env) {
     auto args = vectorize(params[1]);
     return env.apply(params[0], args);
 }
 
-ValuePtr Builtins::eval(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
+ValuePtr Builtins::eval(std::span<const ValuePtr> params, EvalEnv& env) {
     return env.eval(params[0]);
 }
 
-ValuePtr Builtins::exit(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 0, 1);
-
+ValuePtr Builtins::exit(std::span<const ValuePtr> params, EvalEnv& env) {
     int code = 0;
-    if (!params.empty()) code = static_cast<int>(params[0]->asNumber());
+    if (!params.empty()) code = static_cast<int>(params[0].asNumber());
 
     std::cout << "Program terminated with exit(" + std::to_string(code) + ")"
               << std::endl;
     std::exit(code);
 }
 
-ValuePtr Builtins::display(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::display(std::span<const ValuePtr> params, EvalEnv& env) {
     for (auto& val : params) {
-        if (auto str = std::dynamic_pointer_cast<StringValue>(val))
+        if (auto str = val.cast<StringValue>())
             std::cout << str->getVal();
         else
-            std::cout << val->toString();
+            std::cout << val.toString();
     }
-    return std::make_shared<NilValue>();
+    return ValuePtr::nil();
 }
 
-ValuePtr Builtins::newline(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::newline(std::span<const ValuePtr> params, EvalEnv& env) {
     std::cout << std::endl;
-    return std::make_shared<NilValue>();
+    return ValuePtr::nil();
 }
 
-ValuePtr Builtins::displayln(const std::vector<ValuePtr>& params,
-                             EvalEnv& env) {
+ValuePtr Builtins::displayln(std::span<const ValuePtr> params, EvalEnv& env) {
     display(params, env);
     return newline({}, env);
 }
 
-ValuePtr Builtins::print(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::print(std::span<const ValuePtr> params, EvalEnv& env) {
     for (auto& val : params) {
-        std::cout << val->toString() << std::endl;
+        std::cout << val.toString() << std::endl;
     }
-    return std::make_shared<NilValue>();
+    return ValuePtr::nil();
 }
 
-ValuePtr Builtins::error(const std::vector<ValuePtr>& params, EvalEnv& env) {
+ValuePtr Builtins::error(std::span<const ValuePtr> params, EvalEnv& env) {
     if (params.empty()) throw LispError("0");
-    throw LispError(params[0]->toString());
+    throw LispError(params[0].toString());
 }
 
 // comp
 
-ValuePtr Builtins::isEq(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
-
-    if ((Value::isNumeric(params[0]) || Value::isSymbol(params[0]) ||
-         Value::isBoolean(params[0]) || Value::isNil(params[0])) &&
-        params[0]->toString() == params[1]->toString())
-        return std::make_shared<BooleanValue>(true);
-    return std::make_shared<BooleanValue>(params[0] == params[1]);
+ValuePtr Builtins::isEq(std::span<const ValuePtr> params, EvalEnv& env) {
+    // immediates compare by value and symbols are interned, so identity
+    // is enough for every type
+    return ValuePtr::fromBool(params[0] == params[1]);
 }
 
-ValuePtr Builtins::isEqualValue(const std::vector<ValuePtr>& params,
+ValuePtr Builtins::isEqualValue(std::span<const ValuePtr> params,
                                 EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+    return ValuePtr::fromBool(params[0].toString() == params[1].toString());
+}
 
-    return std::make_shared<BooleanValue>(params[0]->toString() ==
-                                          params[1]->toString());
+ValuePtr Builtins::isNot(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(Value::isVirtual(params[0]));
 }
 
-ValuePtr Builtins::isNot(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
+ValuePtr Builtins::greater(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(compareNumbers(params[0], params[1]) > 0);
+}
 
-    return std::make_shared<BooleanValue>(Value::isVirtual(params[0]));
+ValuePtr Builtins::lesser(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(compareNumbers(params[0], params[1]) < 0);
 }
 
-ValuePtr Builtins::greater(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+ValuePtr Builtins::equalNum(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(compareNumbers(params[0], params[1]) == 0);
+}
 
-    auto nums = numericalize(params);
-    return std::make_shared<BooleanValue>(nums[0] > nums[1]);
+ValuePtr Builtins::greaterOrEqual(std::span<const ValuePtr> params,
+                                  EvalEnv& env) {
+    return ValuePtr::fromBool(compareNumbers(params[0], params[1]) >= 0);
 }
 
-ValuePtr Builtins::lesser(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+ValuePtr Builtins::lesserOrEqual(std::span<const ValuePtr> params,
+                                 EvalEnv& env) {
+    return ValuePtr::fromBool(compareNumbers(params[0], params[1]) <= 0);
+}
 
-    auto nums = numericalize(params);
-    return std::make_shared<BooleanValue>(nums[0] < nums[1]);
+ValuePtr Builtins::isZero(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (params[0].isFixnum())
+        return ValuePtr::fromBool(params[0].fixnum() == 0);
+    if (params[0].isBignum()) return ValuePtr::fromBool(false);
+    if (Value::isNumeric(params[0]))
+        return ValuePtr::fromBool(params[0].asNumber() == 0.0);
+    return ValuePtr::fromBool(false);
+}
+
+ValuePtr Builtins::isEven(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (params[0].isFixnum())
+        return ValuePtr::fromBool(params[0].fixnum() % 2 == 0);
+    if (auto big = params[0].cast<BigIntValue>())
+        return ValuePtr::fromBool(!big->getVal().isOdd());
+    double num = params[0].asNumber();
+    return ValuePtr::fromBool(std::fmod(num, 2) == 0.0);
+}
+
+ValuePtr Builtins::isOdd(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (params[0].isFixnum())
+        return ValuePtr::fromBool(params[0].fixnum() % 2 != 0);
+    if (auto big = params[0].cast<BigIntValue>())
+        return ValuePtr::fromBool(big->getVal().isOdd());
+    double num = params[0].asNumber();
+    return ValuePtr::fromBool(std::fmod(num, 2) != 0.0 &&
+                              std::fmod(num, 1) == 0.0);
+}
+
+ValuePtr Builtins::max(std::span<const ValuePtr> params, EvalEnv& env) {
+    auto nums = vectorize(params[0]);
+    checkArgNum(nums, 1);
+    auto res = nums[0];
+    bool exact = true;
+    for (auto& num : nums) {
+        if (compareNumbers(num, res) > 0) res = num;
+        exact = exact && num.isExactInteger();
+    }
+    // inexact if any of the numbers is
+    return exact ? res : ValuePtr::fromNumber(res.asNumber());
+}
+
+ValuePtr Builtins::min(std::span<const ValuePtr> params, EvalEnv& env) {
+    auto nums = vectorize(params[0]);
+    checkArgNum(nums, 1);
+    auto res = nums[0];
+    bool exact = true;
+    for (auto& num : nums) {
+        if (compareNumbers(num, res) < 0) res = num;
+        exact = exact && num.isExactInteger();
+    }
+    return exact ? res : ValuePtr::fromNumber(res.asNumber());
 }
 
-ValuePtr Builtins::equalNum(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+ValuePtr Builtins::listRef(std::span<const ValuePtr> params, EvalEnv& env) {
+    // the same range check: the tail is a pair
+    return listTail(params, env).cast<PairValue>()->car();
+}
 
-    auto nums = numericalize(params);
-    return std::make_shared<BooleanValue>(nums[0] == nums[1]);
+ValuePtr Builtins::listTail(std::span<const ValuePtr> params, EvalEnv& env) {
+    checkList(params[0]);
+    auto idx = asSize(params[1]);
+    auto it = ListIterator(params[0]);
+    for (std::size_t i = 0; i != idx && it != std::default_sentinel; ++i) ++it;
+    if (it == std::default_sentinel)
+        throw LispError("List index out of range: " + params[0].toString() +
+                        "[" + std::to_string(idx) + "]");
+    return it.tail();
 }
 
-ValuePtr Builtins::greaterOrEqual(const std::vector<ValuePtr>& params,
-                                  EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+ValuePtr Builtins::forEach(std::span<const ValuePtr> params, EvalEnv& env) {
+    if (!Value::isProcedure(params[0]))
+        throw TypeError(params[0].toString() + " is not a procedure");
+    checkList(params[1]);
 
-    auto nums = numericalize(params);
-    return std::make_shared<BooleanValue>(nums[0] >= nums[1]);
+    for (auto arg : listElements(params[1])) env.apply(params[0], {&arg, 1});
+    return ValuePtr::nil();
 }
 
-ValuePtr Builtins::lesserOrEqual(const std::vector<ValuePtr>& params,
-                                 EvalEnv& env) {
-    checkArgNum(params, 2, 2);
-
-    auto nums = numericalize(params);
-    return std::make_shared<BooleanValue>(nums[0] <= nums[1]);
+ValuePtr Builtins::listReverse(std::span<const ValuePtr> params, EvalEnv& env) {
+    checkList(params[0]);
+    auto reversed = ValuePtr::nil();
+    for (auto val : listElements(params[0]))
+        reversed = Value::make<PairValue>(val, reversed);
+    return reversed;
 }
 
-ValuePtr Builtins::isZero(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
+ValuePtr Builtins::member(std::span<const ValuePtr> params, EvalEnv& env) {
+    checkList(params[1]);
+    auto key = params[0].toString();
+    auto it = ListIterator(params[1]);
+    while (it != std::default_sentinel && (*it).toString() != key) ++it;
+    if (it == std::default_sentinel) return ValuePtr::fromBool(false);
+    return it.tail();
+}
 
-    if (Value::isNumeric(params[0]))
-        return std::make_shared<BooleanValue>(params[0]->asNumber() == 0.0);
-    return std::make_shared<BooleanValue>(false);
+ValuePtr Builtins::numberToString(std::span<const ValuePtr> params,
+                                  EvalEnv& env) {
+    params[0].asNumber();  // type check
+    return StringValue::from(params[0].toString());
 }
 
-ValuePtr Builtins::isEven(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
+ValuePtr Builtins::stringToNumber(std::span<const ValuePtr> params,
+                                  EvalEnv& env) {
+    auto str = params[0].asString();
+    if (auto integer = parseInteger(str)) return *integer;
+    if (auto num = parseReal(str)) return ValuePtr::fromNumber(*num);
+    throw LispError("Invalid argument: " + std::string(str));
+}
 
-    double num = params[0]->asNumber();
-    return std::make_shared<BooleanValue>(std::fmod(num, 2) == 0.0);
+ValuePtr Builtins::makeStr(std::span<const ValuePtr> params, EvalEnv& env) {
+    double n = params[0].asNumber();
+    if (n < 0)
+        throw LispError("Cannot make string with negative number " +
+                        params[0].toString());
+    char c = ' ';
+    if (params.size() == 2) {
+        auto tmp = params[1].asString();
+        if (tmp.length() != 1)
+            throw TypeError("\"" + std::string(tmp) + "\"" + " is not a char");
+        c = tmp[0];
+    }
+    auto size = n < static_cast<double>(SIZE_MAX) ? static_cast<std::size_t>(n)
+                                                  : SIZE_MAX;
+    Heap::instance().reserve(size);
+    return StringValue::from(std::string(size, c));
 }
 
-ValuePtr Builtins::isOdd(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
+ValuePtr Builtins::strRef(std::span<const ValuePtr> params, EvalEnv& env) {
+    auto str = params[0].asString();
+    std::size_t n = params[1].asNumber();
+    if (n >= str.length() || n < 0)
+        throw LispError("Index " + params[1].toString() +
+                        " is out of bound of \"" + std::string(str) + "\"");
+
+    return StringValue::from(std::string(1, str[n]));
+}
 
-    double num = params[0]->asNumber();
-    return std::make_shared<BooleanValue>(std::fmod(num, 2) != 0.0 &&
-                                          std::fmod(num, 1) == 0.0);
+ValuePtr Builtins::strLength(std::span<const ValuePtr> params, EvalEnv& env) {
+    // no need to flatten a rope
+    auto str = params[0].cast<StringValue>();
+    if (!str) throw TypeError(params[0].toString() + " is not a string!");
+    return ValuePtr::fromInteger(str->size());
 }
 
-ValuePtr Builtins::max(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
+ValuePtr Builtins::subStr(std::span<const ValuePtr> params, EvalEnv& env) {
+    auto str = params[0].cast<StringValue>();
+    if (!str) throw TypeError(params[0].toString() + " is not a string!");
+    std::size_t pos = params[1].asNumber();
+    std::size_t n = std::string::npos;
+    if (params.size() == 3) n = params[2].asNumber();
 
-    auto nums = numericalize(vectorize(params[0]));
-    double res = *ranges::max_element(nums);
-    return std::make_shared<NumericValue>(res);
+    if (n < 0 || pos < 0 || pos >= str->size())
+        throw LispError("Range {pos=" + params[1].toString() + ", n=" +
+                        (params.size() == 3 ? params[2].toString() : "") +
+                        "} out of bound");
+    return StringValue::substr(params[0], pos, n);
 }
 
-ValuePtr Builtins::min(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
+ValuePtr Builtins::strAppend(std::span<const ValuePtr> params, EvalEnv& env) {
+    return StringValue::concat(params[0], params[1]);
+}
 
-    auto nums = numericalize(vectorize(params[0]));
-    double res = *ranges::min_element(nums);
-    return std::make_shared<NumericValue>(res);
+ValuePtr Builtins::strCopy(std::span<const ValuePtr> params, EvalEnv& env) {
+    return Value::make<StringValue>(std::string(params[0].asString()));
 }
 
-ValuePtr Builtins::listRef(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+// vector
 
-    auto vec = vectorize(params[0]);
-    std::size_t idx = params[1]->asNumber();
-    if (idx >= vec.size())
-        throw LispError("List index out of range: " + params[0]->toString() +
-                        "[" + std::to_string(idx) + "]");
-    return vec[idx];
+ValuePtr Builtins::isVector(std::span<const ValuePtr> params, EvalEnv& env) {
+    return ValuePtr::fromBool(params[0].getType() == ValueType::VECTOR);
 }
 
-ValuePtr Builtins::listTail(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+ValuePtr Builtins::makeVector(std::span<const ValuePtr> params,
+                              EvalEnv& env) {
+    auto size = asSize(params[0]);
+    auto fill = params.size() == 2 ? params[1] : ValuePtr::fromInteger(0);
+    Heap::instance().reserve(size * sizeof(ValuePtr));
+    return Value::make<VectorValue>(std::vector<ValuePtr>(size, fill));
+}
 
-    auto vec = vectorize(params[0]);
-    std::size_t idx = params[1]->asNumber();
-    if (idx >= vec.size())
-        throw LispError("List index out of range: " + params[0]->toString() +
-                        "[" + std::to_string(idx) + "]");
-    return Value::makeList({vec.begin() + idx, vec.end()});
+ValuePtr Builtins::vector(std::span<const ValuePtr> params, EvalEnv& env) {
+    return Value::make<VectorValue>(
+        std::vector<ValuePtr>(params.begin(), params.end()));
 }
 
-ValuePtr Builtins::forEach(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+ValuePtr Builtins::vectorLength(std::span<const ValuePtr> params,
+                                EvalEnv& env) {
+    return ValuePtr::fromInteger(asVector(params[0])->getVal().size());
+}
 
-    if (!Value::isProcedure(params[0]))
-        throw TypeError(params[0]->toString() + " is not a procedure");
-    auto list = vectorize(params[1]);
+ValuePtr Builtins::vectorRef(std::span<const ValuePtr> params, EvalEnv& env) {
+    auto elements = asVector(params[0])->getVal();
+    return elements[checkIndex(params[0], elements.size(), params[1])];
+}
 
-    ranges::for_each(list.begin(), list.end(),
-                     [&](ValuePtr arg) { return env.apply(params[0], {arg}); });
-    return std::make_shared<NilValue>();
+ValuePtr Builtins::vectorSet(std::span<const ValuePtr> params, EvalEnv& env) {
+    auto vec = asVector(params[0]);
+    vec->set(checkIndex(params[0], vec->getVal().size(), params[1]),
+             params[2]);
+    return ValuePtr::nil();
 }
 
-ValuePtr Builtins::listReverse(const std::vector<ValuePtr>& params,
-                               EvalEnv& env) {
-    checkArgNum(params, 1, 1);
+ValuePtr Builtins::vectorToList(std::span<const ValuePtr> params,
+                                EvalEnv& env) {
+    ListBuilder list;
+    for (auto& val : asVector(params[0])->getVal()) list.push(val);
+    return list.finish();
+}
 
-    auto ls = vectorize(params[0]);
-    decltype(ls) reversed;
-    std::reverse_copy(ls.begin(), ls.end(), std::back_inserter(reversed));
-    return Value::makeList(reversed);
+ValuePtr Builtins::listToVector(std::span<const ValuePtr> params,
+                                EvalEnv& env) {
+    return Value::make<VectorValue>(vectorize(params[0]));
 }
 
-ValuePtr Builtins::member(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+ValuePtr Builtins::vectorFill(std::span<const ValuePtr> params, EvalEnv& env) {
+    asVector(params[0])->fill(params[1]);
+    return ValuePtr::nil();
+}
 
-    auto ls = vectorize(params[1]);
-    auto it = ls.begin();
-    while (it != ls.end() && (*it)->toString() != params[0]->toString()) ++it;
-    if (it == ls.end()) return std::make_shared<BooleanValue>(false);
-    return Value::makeList({it, ls.end()});
+// f64vector
+
+ValuePtr Builtins::isF64Vector(std::span<const ValuePtr> params,
+                               EvalEnv& env) {
+    return ValuePtr::fromBool(params[0].getType() == ValueType::F64VECTOR);
 }
 
-ValuePtr Builtins::numberToString(const std::vector<ValuePtr>& params,
-                                  EvalEnv& env) {
-    checkArgNum(params, 1);
+ValuePtr Builtins::makeF64Vector(std::span<const ValuePtr> params,
+                                 EvalEnv& env) {
+    auto size = asSize(params[0]);
+    double fill = params.size() == 2 ? params[1].asNumber() : 0.0;
+    Heap::instance().reserve(size * sizeof(double));
+    return Value::make<F64VectorValue>(std::vector<double>(size, fill));
+}
 
-    double num = params[0]->asNumber();
-    std::string str;
-    if (std::fmod(num, 1.0) == 0.0)
-        str = std::to_string(static_cast<int>(num));
-    else
-        str = std::to_string(num);
-    return std::make_shared<StringValue>(str);
+ValuePtr Builtins::f64Vector(std::span<const ValuePtr> params, EvalEnv& env) {
+    std::vector<double> xs;
+    xs.reserve(params.size());
+    for (auto& param : params) xs.push_back(param.asNumber());
+    return Value::make<F64VectorValue>(std::move(xs));
 }
 
-ValuePtr Builtins::stringToNumber(const std::vector<ValuePtr>& params,
-                                  EvalEnv& env) {
-    checkArgNum(params, 1);
-
-    std::string str = params[0]->asString();
-    try {
-        double num = std::stod(str);
-        return std::make_shared<NumericValue>(num);
-    } catch (std::invalid_argument&) {
-        throw LispError("Invalid argument: " + str);
-    }
+ValuePtr Builtins::f64VectorLength(std::span<const ValuePtr> params,
+                                   EvalEnv& env) {
+    return ValuePtr::fromInteger(asF64Vector(params[0]).size());
 }
 
-ValuePtr Builtins::makeStr(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 2);
+ValuePtr Builtins::f64VectorRef(std::span<const ValuePtr> params,
+                                EvalEnv& env) {
+    auto xs = asF64Vector(params[0]);
+    auto i = checkIndex(params[0], xs.size(), params[1]);
+    return ValuePtr::fromNumber(xs[i]);
+}
 
-    double n = params[0]->asNumber();
-    if (n < 0)
-        throw LispError("Cannot make string with negative number " +
-                        params[0]->toString());
-    char c = ' ';
-    if (params.size() == 2) {
-        std::string tmp = params[1]->asString();
-        if (tmp.length() != 1)
-            throw TypeError("\"" + tmp + "\"" + " is not a char");
-        c = tmp[0];
-    }
-    return std::make_shared<StringValue>(
-        std::string(static_cast<std::size_t>(n), c));
+ValuePtr Builtins::f64VectorSet(std::span<const ValuePtr> params,
+                                EvalEnv& env) {
+    auto xs = asF64Vector(params[0]);
+    xs[checkIndex(params[0], xs.size(), params[1])] = params[2].asNumber();
+    return ValuePtr::nil();
 }
 
-ValuePtr Builtins::strRef(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 2);
+ValuePtr Builtins::listToF64Vector(std::span<const ValuePtr> params,
+                                   EvalEnv& env) {
+    checkList(params[0]);
+    std::vector<double> xs;
+    for (auto val : listElements(params[0])) xs.push_back(val.asNumber());
+    return Value::make<F64VectorValue>(std::move(xs));
+}
 
-    std::string str = params[0]->asString();
-    std::size_t n = params[1]->asNumber();
-    if (n >= str.length() || n < 0)
-        throw LispError("Index " + params[1]->toString() +
-                        " is out of bound of \"" + str + "\"");
+ValuePtr Builtins::f64VectorToList(std::span<const ValuePtr> params,
+                                   EvalEnv& env) {
+    ListBuilder list;
+    for (double x : asF64Vector(params[0]))
+        list.push(ValuePtr::fromNumber(x));
+    return list.finish();
+}
+
+ValuePtr Builtins::f64VectorSum(std::span<const ValuePtr> params,
+                                EvalEnv& env) {
+    return ValuePtr::fromNumber(Simd::sum(asF64Vector(params[0])));
+}
 
-    return std::make_shared<StringValue>(std::string(1, str[n]));
+ValuePtr Builtins::f64VectorDot(std::span<const ValuePtr> params,
+                                EvalEnv& env) {
+    auto xs = asF64Vector(params[0]), ys = asF64Vector(params[1]);
+    checkSameLength(xs, ys);
+    return ValuePtr::fromNumber(Simd::dot(xs, ys));
 }
 
-ValuePtr Builtins::strLength(const std::vector<ValuePtr>& params,
-                             EvalEnv& env) {
-    checkArgNum(params, 1, 1);
+ValuePtr Builtins::f64VectorMapAdd(std::span<const ValuePtr> params,
+                                   EvalEnv& env) {
+    auto xs = asF64Vector(params[0]), ys = asF64Vector(params[1]);
+    checkSameLength(xs, ys);
+    std::vector<double> sums(xs.size());
+    Simd::add(xs, ys, sums);
+    return Value::make<F64VectorValue>(std::move(sums));
+}
 
-    std::string str = params[0]->asString();
-    return std::make_shared<NumericValue>(str.length());
+ValuePtr Builtins::f64VectorScale(std::span<const ValuePtr> params,
+                                  EvalEnv& env) {
+    auto xs = asF64Vector(params[0]);
+    std::vector<double> scaled(xs.size());
+    Simd::scale(xs, params[1].asNumber(), scaled);
+    return Value::make<F64VectorValue>(std::move(scaled));
 }
 
-ValuePtr Builtins::subStr(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 2, 3);
+ValuePtr Builtins::f64VectorMin(std::span<const ValuePtr> params,
+                                EvalEnv& env) {
+    auto xs = asF64Vector(params[0]);
+    if (xs.empty())
+        throw LispError("Cannot take the min of an empty f64vector");
+    return ValuePtr::fromNumber(Simd::min(xs));
+}
 
-    std::string str = params[0]->asString();
-    std::size_t pos = params[1]->asNumber();
-    std::size_t n = std::string::npos;
-    if (params.size() == 3) n = params[2]->asNumber();
-
-    if (n < 0 || pos < 0 || pos >= str.length())
-        throw LispError("Range {pos=" + params[1]->toString() +
-                        ", n=" + params[2]->toString() + "} out of bound");
-    return std::make_shared<StringValue>(str.substr(pos, n));
-}
-
-ValuePtr Builtins::strAppend(const std::vector<ValuePtr>& params,
-                             EvalEnv& env) {
-    checkArgNum(params, 2, 2);
-
-    std::string str0 = params[0]->asString();
-    std::string str1 = params[1]->asString();
-    return std::make_shared<StringValue>(str0 + str1);
-}
-
-ValuePtr Builtins::strCopy(const std::vector<ValuePtr>& params, EvalEnv& env) {
-    checkArgNum(params, 1, 1);
-
-    std::string str = params[0]->asString();
-    return std::make_shared<StringValue>(str);
-}
-
-extern const std::unordered_map<std::string, BuiltinFuncType*>
-    Builtins::builtin_forms = {{"+", add},
-                               {"-", subtract},
-                               {"*", multiply},
-                               {"/", divide},
-                               {"abs", abs},
-                               {"expt", expt},
-                               {"quotient", quotient},
-                               {"modulo", modulo},
-                               {"remainder", remainder},  // calc
-                               {"car", car},
-                               {"cdr", cdr},
-                               {"append", append},
-                               {"cons", cons},
-                               {"length", length},
-                               {"list", list},
-                               {"map", map},
-                               {"filter", filter},
-                               {"reduce", reduce},  // pair and list
-                               {"atom?", isAtom},
-                               {"boolean?", isBoolean},
-                               {"integer?", isInteger},
-                               {"list?", isList},
-                               {"number?", isNumber},
-                               {"null?", isNull},
-                               {"pair?", isPair},
-                               {"procedure?", isProcedure},
-                               {"string?", isString},
-                               {"symbol?", isSymbol},  // type
-                               {"apply", apply},
-                               {"eval", eval},
-                               {"display", display},
-                               {"newline", newline},
-                               {"displayln", displayln},
-                               {"print", print},
-                               {"error", error},
-                               {"exit", exit},  // core
-                               {"eq?", isEq},
-                               {"equal?", isEqualValue},
-                               {"not", isNot},
-                               {"=", equalNum},
-                               {">", greater},
-                               {"<", lesser},
-                               {">=", greaterOrEqual},
-                               {"<=", lesserOrEqual},
-                               {"zero?", isZero},
-                               {"odd?", isOdd},
-                               {"even?", isEven},  // comp
-                               {"max", max},
-                               {"min", min},
-                               {"list-ref", listRef},
-                               {"list-tail", listTail},
-                               {"for-each", forEach},
-                               {"reverse", listReverse},
-                               {"member", member},
-                               {"number->string", numberToString},
-                               {"string->number", stringToNumber},
-                               {"make-string", makeStr},
-                               {"string-ref", strRef},
-                               {"string-length", strLength},
-                               {"string-append", strAppend},
-                               {"string-copy", strCopy},
-                               {"substring", subStr}};
\ No newline at end of file
+ValuePtr Builtins::f64VectorMax(std::span<const ValuePtr> params,
+                                EvalEnv& env) {
+    auto xs = asF64Vector(params[0]);
+    if (xs.empty())
+        throw LispError("Cannot take the max of an empty f64vector");
+    return ValuePtr::fromNumber(Simd::max(xs));
+}
+
+extern const std::unordered_map<std::string, Builtins::BuiltinSpec>
+    Builtins::builtin_forms = {
+        {"+", {add, 0, VARIADIC}},
+        {"-", {subtract, 1, 2}},
+        {"*", {multiply, 0, VARIADIC}},
+        {"/", {divide, 1, 2}},
+        {"abs", {abs, 1, 1}},
+        {"expt", {expt, 2, 2}},
+        {"quotient", {quotient, 2, 2}},
+        {"modulo", {modulo, 2, 2}},
+        {"remainder", {remainder, 2, 2}},  // calc
+        {"car", {car, 1, 1}},
+        {"cdr", {cdr, 1, 1}},
+        {"append", {append, 0, VARIADIC}},
+        {"cons", {cons, 2, 2}},
+        {"length", {length, 1, 1}},
+        {"list", {list, 0, VARIADIC}},
+        {"map", {map, 2, 2}},
+        {"filter", {filter, 2, 2}},
+        {"reduce", {reduce, 2, 2}},  // pair and list
+        {"atom?", {isAtom, 1, 1}},
+        {"boolean?", {isBoolean, 1, 1}},
+        {"integer?", {isInteger, 1, 1}},
+        {"list?", {isList, 1, 1}},
+        {"number?", {isNumber, 1, 1}},
+        {"null?", {isNull, 1, 1}},
+        {"pair?", {isPair, 1, 1}},
+        {"procedure?", {isProcedure, 1, 1}},
+        {"string?", {isString, 1, 1}},
+        {"symbol?", {isSymbol, 1, VARIADIC}},  // type
+        {"apply", {apply, 2, 2}},
+        {"eval", {eval, 1, 1}},
+        {"display", {display, 0, VARIADIC}},
+        {"newline", {newline, 0, VARIADIC}},
+        {"displayln", {displayln, 0, VARIADIC}},
+        {"print", {print, 0, VARIADIC}},
+        {"error", {error, 0, VARIADIC}},
+        {"exit", {exit, 0, 1}},  // core
+        {"eq?", {isEq, 2, 2}},
+        {"equal?", {isEqualValue, 2, 2}},
+        {"not", {isNot, 1, 1}},
+        {"=", {equalNum, 2, 2}},
+        {">", {greater, 2, 2}},
+        {"<", {lesser, 2, 2}},
+        {">=", {greaterOrEqual, 2, 2}},
+        {"<=", {lesserOrEqual, 2, 2}},
+        {"zero?", {isZero, 1, 1}},
+        {"odd?", {isOdd, 1, 1}},
+        {"even?", {isEven, 1, 1}},  // comp
+        {"max", {max, 1, 1}},
+        {"min", {min, 1, 1}},
+        {"list-ref", {listRef, 2, 2}},
+        {"list-tail", {listTail, 2, 2}},
+        {"for-each", {forEach, 2, 2}},
+        {"reverse", {listReverse, 1, 1}},
+        {"member", {member, 2, 2}},
+        {"number->string", {numberToString, 1, VARIADIC}},
+        {"string->number", {stringToNumber, 1, VARIADIC}},
+        {"make-string", {makeStr, 1, 2}},
+        {"string-ref", {strRef, 2, 2}},
+        {"string-length", {strLength, 1, 1}},
+        {"string-append", {strAppend, 2, 2}},
+        {"string-copy", {strCopy, 1, 1}},
+        {"substring", {subStr, 2, 3}},
+        {"vector?", {isVector, 1, 1}},
+        {"make-vector", {makeVector, 1, 2}},
+        {"vector", {vector, 0, VARIADIC}},
+        {"vector-length", {vectorLength, 1, 1}},
+        {"vector-ref", {vectorRef, 2, 2}},
+        {"vector-set!", {vectorSet, 3, 3}},
+        {"vector->list", {vectorToList, 1, 1}},
+        {"list->vector", {listToVector, 1, 1}},
+        {"vector-fill!", {vectorFill, 2, 2}},
+        {"f64vector?", {isF64Vector, 1, 1}},
+        {"make-f64vector", {makeF64Vector, 1, 2}},
+        {"f64vector", {f64Vector, 0, VARIADIC}},
+        {"f64vector-length", {f64VectorLength, 1, 1}},
+        {"f64vector-ref", {f64VectorRef, 2, 2}},
+        {"f64vector-set!", {f64VectorSet, 3, 3}},
+        {"list->f64vector", {listToF64Vector, 1, 1}},
+        {"f64vector->list", {f64VectorToList, 1, 1}},
+        {"f64vector-sum", {f64VectorSum, 1, 1}},
+        {"f64vector-dot", {f64VectorDot, 2, 2}},
+        {"f64vector-map+", {f64VectorMapAdd, 2, 2}},
+        {"f64vector-scale", {f64VectorScale, 2, 2}},
+        {"f64vector-min", {f64VectorMin, 1, 1}},
+        {"f64vector-max", {f64VectorMax, 1, 1}}};
\ No newline at end of file
@@ -1,15 +1,28 @@
 #ifndef BUILTINS_H
 #define BUILTINS_H
 
+#include <limits>
+#include <string>
+#include <unordered_map>
+
 #include "./value.h"
 
 namespace Builtins {
 
+constexpr std::size_t VARIADIC = std::numeric_limits<std::size_t>::max();
+
+// registration of a builtin, see BuiltinProcValue
+struct BuiltinSpec {
+    BuiltinFuncType* func;
+    std::size_t min_args;
+    std::size_t max_args;
+};
+
 // helper functions
-void checkArgNum(const std::vector<ValuePtr>& params, std::size_t min,
-                 std::size_t max = std::numeric_limits<std::size_t>::max());
+void checkArgNum(std::span<const ValuePtr> params, std::size_t min,
+                 std::size_t max = VARIADIC);
+void checkList(const ValuePtr& ls);  // throws unless a proper list
 std::vector<ValuePtr> vectorize(const ValuePtr& ls);
-std::vector<double> numericalize(const std::vector<ValuePtr>& vals);
 
 
 // calc 9
@@ -86,9 +99,36 @@ BuiltinFuncType strAppend;
 BuiltinFuncType strCopy;
 BuiltinFuncType subStr;
 
+// vector
+BuiltinFuncType isVector;
+BuiltinFuncType makeVector;
+BuiltinFuncType vector;
+BuiltinFuncType vectorLength;
+BuiltinFuncType vectorRef;
+BuiltinFuncType vectorSet;
+BuiltinFuncType vectorToList;
+BuiltinFuncType listToVector;
+BuiltinFuncType vectorFill;
+
+// f64vector
+BuiltinFuncType isF64Vector;
+BuiltinFuncType makeF64Vector;
+BuiltinFuncType f64Vector;
+BuiltinFuncType f64VectorLength;
+BuiltinFuncType f64VectorRef;
+BuiltinFuncType f64VectorSet;
+BuiltinFuncType listToF64Vector;
+BuiltinFuncType f64VectorToList;
+BuiltinFuncType f64VectorSum;
+BuiltinFuncType f64VectorDot;
+BuiltinFuncType f64VectorMapAdd;  // f64vector-map+
+BuiltinFuncType f64VectorScale;
+BuiltinFuncType f64VectorMin;
+BuiltinFuncType f64VectorMax;
+
 
 // 51 std builtin forms, including 4 overloads
-extern const std::unordered_map<std::string, BuiltinFuncType*> builtin_forms;
+extern const std::unordered_map<std::string, BuiltinSpec> builtin_forms;
 };  // namespace Builtins
 
 #endif
\ No newline at end of file
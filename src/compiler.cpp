@@ -0,0 +1,316 @@
+#include "./compiler.h"
+
+#include <algorithm>
+#include <memory>
+#include <ranges>
+
+#include "./builtins.h"
+#include "./error.h"
+#include "./forms.h"
+#include "./vm.h"
+
+using Builtins::checkArgNum, Builtins::vectorize, SpecialForm::isUnquote;
+
+const std::unordered_map<SpecialFormType*, Compiler::FormCompiler>
+    Compiler::form_list{
+        {SpecialForm::defineForm, &Compiler::compileDefine},
+        {SpecialForm::lambdaForm, &Compiler::compileLambda},
+        {SpecialForm::quoteForm, &Compiler::compileQuote},
+        {SpecialForm::ifForm, &Compiler::compileIf},
+        {SpecialForm::andForm, &Compiler::compileAnd},
+        {SpecialForm::orForm, &Compiler::compileOr},
+        {SpecialForm::beginForm, &Compiler::compileBegin},
+        {SpecialForm::letForm, &Compiler::compileLet},
+        {SpecialForm::condForm, &Compiler::compileCond},
+        {SpecialForm::quasiquoteForm, &Compiler::compileQuasiquote}};
+
+Bytecode Compiler::compileTop(const ValuePtr& expr) {
+    Bytecode bytecode;
+    Compiler compiler;
+    compiler.out = &bytecode;
+    compiler.compile(expr, true);
+    compiler.emit(OpCode::RETURN);
+    return bytecode;
+}
+
+void Compiler::emit(OpCode op, std::initializer_list<std::uint32_t> operands) {
+    out->code.push_back(static_cast<std::uint32_t>(op));
+    out->code.insert(out->code.end(), operands);
+}
+
+std::size_t Compiler::emitJump(OpCode op) {
+    emit(op, {0});
+    return out->code.size() - 1;
+}
+
+void Compiler::patchJump(std::size_t at) {
+    out->code[at] = static_cast<std::uint32_t>(out->code.size());
+}
+
+std::uint32_t Compiler::addConstant(ValuePtr val) {
+    out->constants.push_back(std::move(val));
+    return static_cast<std::uint32_t>(out->constants.size() - 1);
+}
+
+void Compiler::compile(const ValuePtr& expr, bool tail) {
+    auto bytecode = out;
+    auto size = out->code.size();
+    auto depth = scopes.size();
+    try {
+        compileExpr(expr, tail);
+    } catch (Error&) {
+        out = bytecode;
+        out->code.resize(size);
+        scopes.resize(depth);
+        compileNode(expr);
+    }
+}
+
+void Compiler::compileExpr(const ValuePtr& expr, bool tail) {
+    switch (expr.getType()) {
+        case ValueType::NUMERIC:
+        case ValueType::BOOLEAN:
+        case ValueType::STRING:
+        case ValueType::VECTOR:
+            emit(OpCode::CONST, {addConstant(expr)});
+            return;
+        case ValueType::SYMBOL: compileVariable(expr.asSymbolId()); return;
+        case ValueType::PAIR: break;
+        // the analyzer reports everything else when the node runs
+        default: compileNode(expr); return;
+    }
+    if (!Value::isList(expr)) return compileNode(expr);
+
+    auto ls = expr.cast<PairValue>();
+    if (auto form = SpecialForm::formOf(expr)) {
+        auto it = form_list.find(form);
+        if (it == form_list.end()) return compileNode(expr);
+        return (this->*it->second)(ls->cdr().toVector(), tail);
+    }
+
+    auto head = ls->car();
+
+    // the head is evaluated (or taken as is) like in Analyzer
+    if (Value::isList(head) || Value::isSymbol(head))
+        compile(head, false);
+    else
+        emit(OpCode::CONST, {addConstant(head)});
+
+    auto operands = ls->cdr().toVector();
+    for (auto& operand : operands) compile(operand, false);
+    auto argc = static_cast<std::uint32_t>(operands.size());
+    emit(tail ? OpCode::TAIL_CALL : OpCode::CALL, {argc});
+}
+
+void Compiler::compileVariable(SymbolId name) {
+    std::uint32_t depth = 0;
+    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it, ++depth) {
+        int slot = (*it)->slotOf(name);
+        if (slot >= 0)
+            return emit(OpCode::LOCAL,
+                        {depth, static_cast<std::uint32_t>(slot)});
+    }
+    emit(OpCode::GLOBAL, {name});
+}
+
+void Compiler::compileBody(const std::vector<ValuePtr>& exprs, bool tail) {
+    for (std::size_t i = 0; i != exprs.size() - 1; ++i) {
+        compile(exprs[i], false);
+        emit(OpCode::POP);
+    }
+    compile(exprs.back(), tail);
+}
+
+void Compiler::compileProcedure(const std::vector<SymbolId>& params,
+                                const std::vector<ValuePtr>& body) {
+    auto scope = Analyzer::makeScope(params, body);
+    auto enclosing = out;
+    Bytecode bytecode;
+
+    out = &bytecode;
+    scopes.push_back(scope.cast<ScopeValue>());
+    compileBody(body, true);
+    emit(OpCode::RETURN);
+    scopes.pop_back();
+    out = enclosing;
+
+    auto node = std::make_shared<BytecodeNode>(std::move(bytecode));
+    out->lambdas.emplace_back(scope, std::move(node));
+    auto index = static_cast<std::uint32_t>(out->lambdas.size() - 1);
+    emit(OpCode::CLOSURE, {index});
+}
+
+void Compiler::compileDefinition(ValuePtr name) {
+    int slot = scopes.empty() ? -1 : scopes.back()->slotOf(name.asSymbolId());
+    auto index = addConstant(std::move(name));
+    if (slot < 0)
+        emit(OpCode::DEFINE, {index});
+    else
+        emit(OpCode::DEFINE_LOCAL, {static_cast<std::uint32_t>(slot), index});
+}
+
+void Compiler::compileNode(const ValuePtr& expr) {
+    out->nodes.push_back(Analyzer(scopes).analyze(expr));
+    emit(OpCode::EXEC, {static_cast<std::uint32_t>(out->nodes.size() - 1)});
+}
+
+void Compiler::compileDefine(const std::vector<ValuePtr>& args, bool tail) {
+    checkArgNum(args, 2);
+
+    // names are checked before anything is compiled: a bad one makes the
+    // form fall back to the analyzer, which rejects it before the value runs
+    if (Value::isList(args[0])) {
+        auto signature = args[0].toVector();
+        if (signature.empty())
+            throw LispError("Malformed define form: " + args[0].toString());
+
+        for (auto& name : signature) name.asSymbolId();
+        std::vector<ValuePtr> lambda_args{args};
+        lambda_args[0] =
+            Value::makeList({signature.begin() + 1, signature.end()});
+        compileLambda(lambda_args, false);
+        compileDefinition(signature[0]);
+    } else {
+        checkArgNum(args, 2, 2);
+        args[0].asSymbolId();
+        compile(args[1], false);
+        compileDefinition(args[0]);
+    }
+}
+
+void Compiler::compileLambda(const std::vector<ValuePtr>& args, bool tail) {
+    checkArgNum(args, 2);
+
+    std::vector<SymbolId> params;
+    std::ranges::transform(args[0].toVector(), std::back_inserter(params),
+                           [](ValuePtr val) { return val.asSymbolId(); });
+    compileProcedure(params, {args.begin() + 1, args.end()});
+}
+
+void Compiler::compileQuote(const std::vector<ValuePtr>& args, bool tail) {
+    checkArgNum(args, 1, 1);
+    emit(OpCode::CONST, {addConstant(args[0])});
+}
+
+void Compiler::compileIf(const std::vector<ValuePtr>& args, bool tail) {
+    checkArgNum(args, 2);
+
+    compile(args[0], false);
+    auto otherwise = emitJump(OpCode::JUMP_IF_FALSE);
+    compile(args[1], tail);
+    auto end = emitJump(OpCode::JUMP);
+    patchJump(otherwise);
+    if (args.size() < 3)
+        emit(OpCode::CONST, {addConstant(ValuePtr::nil())});
+    else
+        compile(args[2], tail);
+    patchJump(end);
+}
+
+void Compiler::compileAnd(const std::vector<ValuePtr>& args, bool tail) {
+    if (args.empty())
+        return emit(OpCode::CONST, {addConstant(ValuePtr::fromBool(true))});
+
+    std::vector<std::size_t> ends;
+    for (std::size_t i = 0; i != args.size() - 1; ++i) {
+        compile(args[i], false);
+        ends.push_back(emitJump(OpCode::JUMP_IF_FALSE_KEEP));
+    }
+    compile(args.back(), tail);
+    for (auto end : ends) patchJump(end);
+}
+
+void Compiler::compileOr(const std::vector<ValuePtr>& args, bool tail) {
+    if (args.empty())
+        return emit(OpCode::CONST, {addConstant(ValuePtr::fromBool(false))});
+
+    std::vector<std::size_t> ends;
+    for (std::size_t i = 0; i != args.size() - 1; ++i) {
+        compile(args[i], false);
+        ends.push_back(emitJump(OpCode::JUMP_IF_TRUE_KEEP));
+    }
+    compile(args.back(), tail);
+    for (auto end : ends) patchJump(end);
+}
+
+void Compiler::compileBegin(const std::vector<ValuePtr>& args, bool tail) {
+    checkArgNum(args, 1);
+    compileBody(args, tail);
+}
+
+void Compiler::compileLet(const std::vector<ValuePtr>& args, bool tail) {
+    checkArgNum(args, 2);
+
+    std::vector<SymbolId> names;
+    for (auto& bind : vectorize(args[0])) {
+        auto bind_vec = vectorize(bind);
+        checkArgNum(bind_vec, 2, 2);
+
+        names.push_back(bind_vec[0].asSymbolId());
+        compile(bind_vec[1], false);
+    }
+
+    std::vector<ValuePtr> body{args.begin() + 1, args.end()};
+    auto scope = Analyzer::makeScope(names, body);
+    emit(OpCode::ENTER, {addConstant(scope),
+                         static_cast<std::uint32_t>(names.size())});
+    scopes.push_back(scope.cast<ScopeValue>());
+    compileBody(body, tail);
+    scopes.pop_back();
+    // in tail position the frame is dropped by RETURN or TAIL_CALL
+    if (!tail) emit(OpCode::LEAVE);
+}
+
+void Compiler::compileCond(const std::vector<ValuePtr>& args, bool tail) {
+    std::vector<std::vector<ValuePtr>> clauses;
+    for (std::size_t i = 0; i != args.size(); ++i) {
+        clauses.push_back(vectorize(args[i]));
+        checkArgNum(clauses.back(), 1);
+        if (clauses.back()[0].toString() == "else" && i != args.size() - 1)
+            throw LispError("Bad syntax: else clause must appear at the end");
+    }
+
+    std::vector<std::size_t> ends;
+    bool has_else = false;
+    for (auto& clause : clauses) {
+        std::vector<ValuePtr> body{clause.begin() + 1, clause.end()};
+        if (clause[0].toString() == "else") {
+            has_else = true;
+            if (body.empty())
+                emit(OpCode::CONST, {addConstant(ValuePtr::fromBool(true))});
+            else
+                compileBody(body, tail);
+            break;
+        }
+
+        compile(clause[0], false);
+        if (body.empty()) {
+            ends.push_back(emitJump(OpCode::JUMP_IF_TRUE_KEEP));
+            continue;
+        }
+        auto next = emitJump(OpCode::JUMP_IF_FALSE);
+        compileBody(body, tail);
+        ends.push_back(emitJump(OpCode::JUMP));
+        patchJump(next);
+    }
+    if (!has_else) emit(OpCode::CONST, {addConstant(ValuePtr::nil())});
+    for (auto end : ends) patchJump(end);
+}
+
+void Compiler::compileQuasiquote(const std::vector<ValuePtr>& args,
+                                 bool tail) {
+    checkArgNum(args, 1, 1);
+    if (!Value::isPair(args[0]) || !Value::isList(args[0]))
+        return emit(OpCode::CONST, {addConstant(args[0])});
+    if (isUnquote(args[0])) return compile(args[0].toVector()[1], false);
+
+    // only the unquoted elements are evaluated, the rest is copied as is
+    auto quoted = args[0].toVector();
+    for (auto& expr : quoted) {
+        if (isUnquote(expr))
+            compile(expr.toVector()[1], false);
+        else
+            emit(OpCode::CONST, {addConstant(expr)});
+    }
+    emit(OpCode::MAKE_LIST, {static_cast<std::uint32_t>(quoted.size())});
+}
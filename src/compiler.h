@@ -0,0 +1,88 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "./analyzer.h"
+#include "./value.h"
+
+// Instructions of the stack VM, each followed by its operands. Targets are
+// indices into Bytecode::code.
+enum class OpCode : std::uint32_t {
+    CONST,               // idx: push constants[idx]
+    LOCAL,               // depth slot: push a frame slot
+    GLOBAL,              // name: push the binding of `name`, by name
+    DEFINE_LOCAL,        // slot name: pop into a slot, push constants[name]
+    DEFINE,              // name: pop and bind constants[name] by name
+    POP,                 // drop the top of the stack
+    JUMP,                // target
+    JUMP_IF_FALSE,       // target: pop, jump if it was #f
+    JUMP_IF_FALSE_KEEP,  // target: jump if the top is #f, else pop it
+    JUMP_IF_TRUE_KEEP,   // target: jump unless the top is #f, else pop it
+    CLOSURE,             // idx: push a lambda of lambdas[idx]
+    ENTER,               // scope argc: pop argc values into a child frame
+    LEAVE,               // return to the parent frame
+    MAKE_LIST,           // n: pop n values, push them as a list
+    EXEC,                // idx: push the value of nodes[idx]
+    CALL,                // argc: pop procedure and arguments, push result
+    TAIL_CALL,           // argc: call replacing the running procedure
+    RETURN,              // pop the result of the running procedure
+};
+
+// Compiled code of a top-level form or lambda body.
+struct Bytecode {
+    std::vector<std::uint32_t> code;
+    std::vector<Pinned> constants;
+    std::vector<std::pair<Pinned, NodePtr>> lambdas;  // scope and body
+    std::vector<NodePtr> nodes;  // forms the VM leaves to the analyzer
+};
+
+// Compiles expressions into Bytecode, with the same lexical addressing as
+// the Analyzer. Special forms without an instruction sequence of their own
+// (and ill-formed expressions, whose errors are deferred) are analyzed and
+// run through EXEC.
+class Compiler {
+private:
+    using FormCompiler = void (Compiler::*)(const std::vector<ValuePtr>&,
+                                           bool);
+    // special forms with instructions of their own
+    static const std::unordered_map<SpecialFormType*, FormCompiler>
+        form_list;
+
+    std::vector<const ScopeValue*> scopes;  // innermost last
+    Bytecode* out;
+
+    void emit(OpCode op, std::initializer_list<std::uint32_t> operands = {});
+    std::size_t emitJump(OpCode op);
+    void patchJump(std::size_t at);
+    std::uint32_t addConstant(ValuePtr val);
+
+    void compile(const ValuePtr& expr, bool tail);
+    void compileExpr(const ValuePtr& expr, bool tail);
+    void compileVariable(SymbolId name);
+    void compileBody(const std::vector<ValuePtr>& exprs, bool tail);
+    void compileProcedure(const std::vector<SymbolId>& params,
+                          const std::vector<ValuePtr>& body);
+    void compileDefinition(ValuePtr name);
+    void compileNode(const ValuePtr& expr);
+
+    void compileDefine(const std::vector<ValuePtr>& args, bool tail);
+    void compileLambda(const std::vector<ValuePtr>& args, bool tail);
+    void compileQuote(const std::vector<ValuePtr>& args, bool tail);
+    void compileIf(const std::vector<ValuePtr>& args, bool tail);
+    void compileAnd(const std::vector<ValuePtr>& args, bool tail);
+    void compileOr(const std::vector<ValuePtr>& args, bool tail);
+    void compileBegin(const std::vector<ValuePtr>& args, bool tail);
+    void compileLet(const std::vector<ValuePtr>& args, bool tail);
+    void compileCond(const std::vector<ValuePtr>& args, bool tail);
+    void compileQuasiquote(const std::vector<ValuePtr>& args, bool tail);
+
+public:
+    static Bytecode compileTop(const ValuePtr& expr);
+};
+
+#endif
@@ -3,126 +3,198 @@
 #include <algorithm>
 #include <ranges>
 
+#include "./analyzer.h"
 #include "./builtins.h"
 #include "./error.h"
-#include "./forms.h"
+#include "./gc.h"
 
-std::shared_ptr<EvalEnv> EvalEnv::createGlobal() {
-    auto global = std::shared_ptr<EvalEnv>(new EvalEnv);
+EvalEnv* EvalEnv::createGlobal() {
+    auto global = Value::make<EvalEnv>().cast<EvalEnv>();
+    Heap::pin(global);
 
-    for (auto&& [name, func] : Builtins::builtin_forms)
-        global->symbol_list[name] = std::make_shared<BuiltinProcValue>(func);
+    for (auto&& [name, spec] : Builtins::builtin_forms)
+        global->defineBinding(
+            SymbolValue::intern(name),
+            Value::make<BuiltinProcValue>(spec.func, spec.min_args,
+                                          spec.max_args));
 
     return global;
 }
 
-std::shared_ptr<EvalEnv> EvalEnv::createChild(
-    const std::vector<std::string>& params, const std::vector<ValuePtr>& args) {
-    auto child = std::shared_ptr<EvalEnv>(new EvalEnv(*this));
-    if (params.size() != args.size())
-        throw LispError("Procedure expected " + std::to_string(params.size()) +
-                        " parameters, got " + std::to_string(args.size()));
-    for (unsigned int i = 0; i < params.size(); ++i) {
-        child->symbol_list[params[i]] = args[i];
+FrameSlots::FrameSlots(std::span<const ValuePtr> vals, std::size_t size)
+    : count{static_cast<std::uint32_t>(size)} {
+    if (size > INLINE_SIZE) {
+        spilled = std::make_unique<ValuePtr[]>(size);
+        data = spilled.get();
     }
-    return child;
+    std::ranges::copy(vals, data);
+    std::fill(data + vals.size(), data + size, ValuePtr::unassigned());
 }
 
-std::vector<ValuePtr> EvalEnv::evalList(ValuePtr ls) {
-    std::vector<ValuePtr> result;
-    std::ranges::transform(ls->toVector(), std::back_inserter(result),
-                           [this](ValuePtr v) { return this->eval(v); });
-    return result;
+void FrameSlots::push_back(ValuePtr val) {
+    // only names defined at run time get here, so no spare room is kept
+    if (count >= INLINE_SIZE) {
+        auto grown = std::make_unique<ValuePtr[]>(count + 1);
+        std::copy(data, data + count, grown.get());
+        spilled = std::move(grown);
+        data = spilled.get();
+    }
+    data[count++] = val;
 }
 
-ValuePtr EvalEnv::apply(ValuePtr proc, std::vector<ValuePtr> args) {
-    if (auto func = dynamic_cast<BuiltinProcValue*>(proc.get())) {
-        return func->getVal()(args, *this);
-    } else if (auto func = dynamic_cast<LambdaValue*>(proc.get())) {
-        return func->apply(args);
-    } else
-        throw TypeError(proc->toString() + " is not a procedure");
+EvalEnv* EvalEnv::createChild(ValuePtr scope,
+                              std::span<const ValuePtr> args) {
+    auto frame = scope.cast<ScopeValue>();
+    if (frame->getParamCount() != args.size())
+        throw LispError("Procedure expected " +
+                        std::to_string(frame->getParamCount()) +
+                        " parameters, got " + std::to_string(args.size()));
+    // internal defines start unassigned
+    return Value::make<EvalEnv>(this, scope, args, frame->getNames().size())
+        .cast<EvalEnv>();
 }
 
-void EvalEnv::defineBinding(ValuePtr name, ValuePtr val) {
-    std::string sym = name->asSymbol();
-    this->symbol_list[sym] = val;
+ValuePtr EvalEnv::apply(ValuePtr proc, std::span<const ValuePtr> args) {
+    switch (proc.getType()) {
+        case ValueType::BUILTIN_PROC: {
+            auto builtin = proc.cast<BuiltinProcValue>();
+            Builtins::checkArgNum(args, builtin->getMinArgs(),
+                                  builtin->getMaxArgs());
+            return builtin->getVal()(args, *this);
+        }
+        case ValueType::LAMBDA:
+            return applyLambda(std::move(proc), args);
+        default: throw TypeError(proc.toString() + " is not a procedure");
+    }
 }
 
-ValuePtr& EvalEnv::lookupBinding(std::string name) {
-    if (symbol_list.find(name) == symbol_list.end()) {
-        if (this->parent != nullptr)
-            return this->parent->lookupBinding(name);
-        else
-            throw LispError("Unbound variable " + name);
+ValuePtr EvalEnv::applyLambda(ValuePtr lambda,
+                              std::span<const ValuePtr> args) {
+    // a lambda body ending in another lambda call hands it back through
+    // `tail`, so tail calls loop here in constant stack space
+    TailCall tail;
+    while (true) {
+        auto proc = lambda.cast<LambdaValue>();
+        auto frame = proc->createFrame(args);
+        // nothing else references the frame, nor the body while it runs
+        Pinned pinned_frame{ValuePtr(frame)}, pinned_proc{lambda};
+        Heap::instance().safepoint();
+        auto result = proc->getBody().exec(*frame, &tail);
+        if (!tail.pending) return result;
+
+        tail.pending = false;
+        lambda = std::move(tail.proc);
+        args = tail.args;
     }
-    return symbol_list.at(name);
 }
 
-ValuePtr& EvalEnv::lookupBinding(ValuePtr name) {
-    return lookupBinding(name->asSymbol());
+void EvalEnv::defineBinding(ValuePtr name, ValuePtr val) {
+    auto id = name.asSymbolId();
+    auto& heap = Heap::instance();
+    if (symbol_list) {
+        heap.writeBarrier(this, val);
+        (*symbol_list)[id] = val;
+        return;
+    }
+
+    auto frame = scope.cast<ScopeValue>();
+    int slot = frame->slotOf(id);
+    if (slot < 0) {
+        // a name the analyzer did not see (e.g. defined through eval): give
+        // this frame a private scope with one more slot
+        auto names = frame->getNames();
+        names.push_back(id);
+        scope = Value::make<ScopeValue>(names, frame->getParamCount());
+        heap.writeBarrier(this, scope);
+        slot = static_cast<int>(slots.size());
+        slots.push_back(ValuePtr::nil());
+    }
+    setLocal(slot, val);
 }
 
-std::vector<ValuePtr> EvalEnv::getAllTestsName() {
-    std::vector<ValuePtr> names;
-    for (auto&& [sym, test] : symbol_list) {
-        if (sym.find("@TEST") != std::string::npos) {
-            names.push_back(std::make_shared<SymbolValue>(sym));
+namespace {
+[[noreturn]] void unbound(SymbolId id) {
+    throw LispError("Unbound variable " + SymbolValue::fromId(id).toString());
+}
+}  // namespace
+
+ValuePtr& EvalEnv::lookupBinding(SymbolId id) {
+    // only free variables and code built at runtime get here by name
+    for (auto env = this; env != nullptr; env = env->parent) {
+        if (env->symbol_list) {
+            auto it = env->symbol_list->find(id);
+            if (it != env->symbol_list->end()) return it->second;
+        } else if (int slot = env->scope.cast<ScopeValue>()->slotOf(id);
+                   slot >= 0) {
+            // defined in this frame, but not yet
+            if (env->slots[slot].isUnassigned()) unbound(id);
+            return env->slots[slot];
         }
     }
-    return names;
+    unbound(id);
 }
 
-ValuePtr EvalEnv::eval(ValuePtr expr) {
-    using namespace std::literals;
+ValuePtr& EvalEnv::lookupBinding(ValuePtr name) {
+    return lookupBinding(name.asSymbolId());
+}
 
-    if (Value::isSelfEvaluating(expr))
-        return expr;
+ValuePtr& EvalEnv::lookupLocal(std::uint32_t depth, std::uint32_t slot) {
+    auto env = this;
+    for (std::uint32_t i = 0; i != depth; ++i) env = env->parent;
+    auto& val = env->slots[slot];
+    if (val.isUnassigned())
+        unbound(env->scope.cast<ScopeValue>()->getNames()[slot]);
+    return val;
+}
 
-    else if (Value::isNil(expr))
-        throw LispError("Evaluating nil is prohibited");
+std::string EvalEnv::toString() const {
+    return "#<environment>";
+}
+
+void EvalEnv::trace(Tracer& tracer) const {
+    tracer.mark(parent);
+    tracer.mark(scope);
+    for (auto& slot : slots) tracer.mark(slot);
+    if (symbol_list)
+        for (auto&& [id, val] : *symbol_list) tracer.mark(val);
+}
 
-    else if (Value::isSymbol(expr)) {
-        return lookupBinding(expr);
+std::vector<ValuePtr> EvalEnv::getAllTestsName() {
+    std::vector<SymbolId> ids;
+    for (auto env = this; env != nullptr; env = env->parent) {
+        if (env->symbol_list) {
+            for (auto&& [id, test] : *env->symbol_list) ids.push_back(id);
+        } else {
+            auto& frame_names = env->scope.cast<ScopeValue>()->getNames();
+            ids.insert(ids.end(), frame_names.begin(), frame_names.end());
+        }
     }
 
-    else if (Value::isList(expr)) {
-        auto ls = dynamic_pointer_cast<PairValue>(expr);
-        std::vector<ValuePtr> vec = ls->toVector();
-
-        if (Value::isList(vec[0])) vec[0] = eval(vec[0]);
-
-        if (Value::isSymbol(vec[0])) {
-            std::string name = vec[0]->asSymbol();
-            if (SpecialForm::form_list.find(name) !=
-                SpecialForm::form_list.end()) {
-                // arguments not eval here, eval them inside special forms
-                auto form = SpecialForm::form_list.at(name);
-                return form(ls->cdr()->toVector(), *this);
-            } else {
-                auto proc = lookupBinding(name);
-                std::vector<ValuePtr> args;
-                if (Value::isList(ls->cdr()))
-                    args = evalList(ls->cdr());
-                else
-                    args.push_back(eval(ls->cdr()));
-                return apply(proc, args);
-            }
-        } else if (Value::isProcedure(vec[0])) {
-            std::vector<ValuePtr> args;
-            if (Value::isList(ls->cdr()))
-                args = evalList(ls->cdr());
-            else
-                args.push_back(eval(ls->cdr()));
-            return apply(vec[0], args);
-        } else
-            throw TypeError(vec[0]->toString() + " is not a procedure");
+    std::vector<ValuePtr> names;
+    for (auto id : ids) {
+        auto sym = SymbolValue::fromId(id);
+        if (sym.asSymbol().find("@TEST") != std::string::npos &&
+            std::ranges::find(names, sym) == names.end()) {
+            names.push_back(sym);
+        }
     }
+    return names;
+}
+
+EvalStack& EvalStack::instance() {
+    static EvalStack stack(1 << 16);
+    return stack;
+}
 
-    else if (Value::isPair(expr))
-        throw LispError("Malformed list: " + expr->toString());
+void EvalStack::trace(Tracer& tracer) const {
+    for (std::size_t i = 0; i != top; ++i) tracer.mark(slots[i]);
+}
+
+void EvalStack::overflow() {
+    throw LispError("Stack overflow: too many pending arguments");
+}
 
-    else
-        throw LispError("Unknown expression: " +
-                        expr->toString());  // dead code
+ValuePtr EvalEnv::eval(ValuePtr expr) {
+    Analyzer analyzer;
+    return analyzer.analyze(expr)->exec(*this);
 }
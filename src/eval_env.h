@@ -1,30 +1,163 @@
 #ifndef EVAL_ENV_H
 #define EVAL_ENV_H
 
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "./gc.h"
 #include "./value.h"
 
-class EvalEnv : public std::enable_shared_from_this<EvalEnv> {
+// Slots of a frame. Up to INLINE_SIZE of them are stored in the frame
+// itself, so calling a small procedure allocates its frame and nothing else;
+// larger frames keep them in an array of their own.
+class FrameSlots {
 private:
-    EvalEnv() = default;
-    EvalEnv(std::shared_ptr<EvalEnv> parent) : parent{parent} {}
-    EvalEnv(const EvalEnv& env) : parent{env.parent}, symbol_list(env.symbol_list) {}
+    static constexpr std::size_t INLINE_SIZE = 8;
+
+    std::uint32_t count{0};
+    ValuePtr* data{inline_slots};
+    ValuePtr inline_slots[INLINE_SIZE];
+    std::unique_ptr<ValuePtr[]> spilled;
 
 public:
-    std::shared_ptr<EvalEnv> parent{nullptr};
-    std::unordered_map<std::string, ValuePtr> symbol_list;
+    FrameSlots() = default;
+    // `vals`, then unassigned slots up to `size`
+    FrameSlots(std::span<const ValuePtr> vals, std::size_t size);
+    FrameSlots(const FrameSlots&) = delete;
+    FrameSlots& operator=(const FrameSlots&) = delete;
+
+    std::size_t size() const {
+        return count;
+    }
+    ValuePtr& operator[](std::size_t i) {
+        return data[i];
+    }
+    const ValuePtr* begin() const {
+        return data;
+    }
+    const ValuePtr* end() const {
+        return data + count;
+    }
+    void push_back(ValuePtr val);
+};
 
-    static std::shared_ptr<EvalEnv> createGlobal();
-    std::shared_ptr<EvalEnv> createChild(const std::vector<std::string>& params,
-                                         const std::vector<ValuePtr>& args);
+// Either the global environment, which binds names in a hash table, or a
+// call frame, which holds only the slots of its lambda/let scope and links
+// to the frame the procedure was defined in. Environments are values owned
+// by the Heap like any other, so closures stored in the frame that binds
+// them are collected as well.
+class EvalEnv : public Value {
+    friend class Value;
+
+private:
+    EvalEnv()
+        : Value(ValueType::ENVIRONMENT),
+          symbol_list{
+              std::make_unique<std::unordered_map<SymbolId, ValuePtr>>()} {}
+    EvalEnv(EvalEnv* parent, ValuePtr scope, std::span<const ValuePtr> args,
+            std::size_t size)
+        : Value(ValueType::ENVIRONMENT),
+          parent{parent},
+          scope{scope},
+          slots{args, size} {}
+
+public:
+    static constexpr ValueType TYPE = ValueType::ENVIRONMENT;
+
+    // the fields are read directly; stores go through setLocal and
+    // defineBinding, which apply the write barrier of the Heap
+    EvalEnv* parent{nullptr};
+    ValuePtr scope;                 // ScopeValue naming the slots, () if global
+    FrameSlots slots;               // indexed by the analyzed frame address
+    std::unique_ptr<std::unordered_map<SymbolId, ValuePtr>> symbol_list;
+
+    // the global environment is pinned, it is never collected
+    static EvalEnv* createGlobal();
+    EvalEnv* createChild(ValuePtr scope, std::span<const ValuePtr> args);
 
     ValuePtr eval(ValuePtr expr);
-    std::vector<ValuePtr> evalList(ValuePtr ls);
-    ValuePtr apply(ValuePtr proc, std::vector<ValuePtr> args);
+    ValuePtr apply(ValuePtr proc, std::span<const ValuePtr> args);
+    ValuePtr applyLambda(ValuePtr lambda, std::span<const ValuePtr> args);
     void defineBinding(ValuePtr name, ValuePtr val);
-    ValuePtr& lookupBinding(std::string name);
+    void setLocal(std::uint32_t slot, ValuePtr val) {
+        Heap::instance().writeBarrier(this, val);
+        slots[slot] = val;
+    }
+    ValuePtr& lookupBinding(SymbolId id);
     ValuePtr& lookupBinding(ValuePtr sym);
+    ValuePtr& lookupLocal(std::uint32_t depth, std::uint32_t slot);
     std::vector<ValuePtr> getAllTestsName();
+    std::string toString() const;
+    void trace(Tracer& tracer) const;
+};
+
+// Arguments of the calls being set up, shared by the whole interpreter.
+// The storage is allocated once and never moves, so builtins are passed
+// their arguments as a span into it.
+class EvalStack {
+private:
+    std::unique_ptr<ValuePtr[]> slots;
+    std::size_t capacity;
+    std::size_t top{0};
+
+    explicit EvalStack(std::size_t capacity)
+        : slots{std::make_unique<ValuePtr[]>(capacity)}, capacity{capacity} {}
+    [[noreturn]] static void overflow();
+
+public:
+    static EvalStack& instance();
+
+    std::size_t size() const {
+        return top;
+    }
+    void push(ValuePtr val) {
+        if (top == capacity) overflow();
+        slots[top++] = std::move(val);
+    }
+    void popTo(std::size_t size) {
+        if (top > size) top = size;
+    }
+    std::span<ValuePtr> since(std::size_t size) {
+        return {slots.get() + size, top - size};
+    }
+    // the pending arguments are roots of the Heap
+    void trace(Tracer& tracer) const;
+};
+
+// Arguments pushed onto the EvalStack for one call, popped when it ends.
+class ArgBuffer {
+private:
+    EvalStack& stack{EvalStack::instance()};
+    std::size_t base{stack.size()};
+
+public:
+    ArgBuffer() = default;
+    ArgBuffer(const ArgBuffer&) = delete;
+    ArgBuffer& operator=(const ArgBuffer&) = delete;
+    ~ArgBuffer() {
+        stack.popTo(base);
+    }
+
+    void push(ValuePtr val) {
+        stack.push(std::move(val));
+    }
+    std::span<const ValuePtr> args() {
+        return stack.since(base);
+    }
+    // moves the arguments out, e.g. into the slots of a new frame
+    std::vector<ValuePtr> take() {
+        auto vals = stack.since(base);
+        std::vector<ValuePtr> taken(std::make_move_iterator(vals.begin()),
+                                    std::make_move_iterator(vals.end()));
+        stack.popTo(base);
+        return taken;
+    }
 };
 
 #endif
\ No newline at end of file
@@ -7,297 +7,397 @@
 #include "./boot.h"
 #include "./error.h"
 
-ValuePtr SpecialForm::defineForm(const std::vector<ValuePtr>& args,
-                                 EvalEnv& env) {
+namespace {
+
+// binds `name` to the value of `value` in the frame running the node and
+// yields `name`; symbols are pinned for good, so `name` needs no Pinned
+NodePtr defineNode(ValuePtr name, NodePtr value, Analyzer& analyzer) {
+    int slot = analyzer.localSlot(name.asSymbolId());
+    if (slot < 0) {
+        return makeNode([name, value](EvalEnv& env, TailCall*) {
+            env.defineBinding(name, value->exec(env));
+            return name;
+        });
+    }
+    return makeNode([name, value, slot](EvalEnv& env, TailCall*) {
+        env.setLocal(slot, value->exec(env));
+        return name;
+    });
+}
+
+}  // namespace
+
+SpecialFormType* SpecialForm::formOf(const ValuePtr& expr) {
+    auto ls = expr.cast<PairValue>();
+    if (!ls) return nullptr;
+    auto sym = ls->car().cast<SymbolValue>();
+    return sym ? sym->getForm() : nullptr;
+}
+
+bool SpecialForm::isUnquote(const ValuePtr& expr) {
+    return formOf(expr) == unquoteForm && Value::isList(expr) &&
+           expr.toVector().size() == 2;
+}
+
+NodePtr SpecialForm::defineForm(const std::vector<ValuePtr>& args,
+                                Analyzer& analyzer) {
     checkArgNum(args, 2);
 
     if (Value::isList(args[0])) {
-        auto signature = args[0]->toVector();
+        auto signature = args[0].toVector();
         if (signature.empty())
-            throw LispError("Malformed define form: " + args[0]->toString());
+            throw LispError("Malformed define form: " + args[0].toString());
 
         std::vector<ValuePtr> lambda_args{args};
         lambda_args[0] =
             Value::makeList({signature.begin() + 1, signature.end()});
 
-        auto lambda = lambdaForm(lambda_args, env);
-        env.defineBinding(signature[0], lambda);
-        return quoteForm({signature[0]}, env);
+        auto lambda = lambdaForm(lambda_args, analyzer);
+        return defineNode(signature[0], lambda, analyzer);
     }
 
     else {
         checkArgNum(args, 2, 2);
-        env.defineBinding(args[0], env.eval(args[1]));
-        return quoteForm({args[0]}, env);
+        return defineNode(args[0], analyzer.analyze(args[1]), analyzer);
     }
 }
 
-ValuePtr SpecialForm::lambdaForm(const std::vector<ValuePtr>& args,
-                                 EvalEnv& env) {
+NodePtr SpecialForm::lambdaForm(const std::vector<ValuePtr>& args,
+                                Analyzer& analyzer) {
     // (lambda (a b) ( (if (> b 0) + -) a b))
     checkArgNum(args, 2);
 
-    std::vector<std::string> params;
-    std::ranges::transform(args[0]->toVector(), std::back_inserter(params),
-                           [](ValuePtr val) { return val->asSymbol(); });
+    std::vector<SymbolId> params;
+    std::ranges::transform(args[0].toVector(), std::back_inserter(params),
+                           [](ValuePtr val) { return val.asSymbolId(); });
+    auto [scope, body] =
+        analyzer.analyzeScope(params, {args.begin() + 1, args.end()});
 
-    std::vector<ValuePtr> body(args.begin() + 1, args.end());
-    return std::make_shared<LambdaValue>(params, body, env.shared_from_this());
+    return makeNode([scope = Pinned(scope), body = body](EvalEnv& env,
+                                                         TailCall*) {
+        return Value::make<LambdaValue>(scope, body, &env);
+    });
 }
 
-ValuePtr SpecialForm::ifForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
+NodePtr SpecialForm::ifForm(const std::vector<ValuePtr>& args,
+                            Analyzer& analyzer) {
     checkArgNum(args, 2);
 
-    if (Value::isVirtual(env.eval(args[0]))) {
-        if (args.size() < 3) return std::make_shared<NilValue>();
-        return env.eval(args[2]);
-    }
-    return env.eval(args[1]);
+    auto cond = analyzer.analyze(args[0]);
+    auto then = analyzer.analyze(args[1]);
+    auto otherwise = args.size() < 3 ? nullptr : analyzer.analyze(args[2]);
+
+    return makeNode([cond, then, otherwise](EvalEnv& env, TailCall* tail) {
+        if (!Value::isVirtual(cond->exec(env))) return then->exec(env, tail);
+        if (!otherwise) return ValuePtr::nil();
+        return otherwise->exec(env, tail);
+    });
 }
 
-ValuePtr SpecialForm::andForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
-    if (!args.empty()) {
-        for (std::size_t i = 0; i != args.size(); ++i) {
-            auto val = env.eval(args[i]);
-            if (Value::isVirtual(val))
-                return std::make_shared<BooleanValue>(false);
-            if (i == args.size() - 1) return val;
+NodePtr SpecialForm::andForm(const std::vector<ValuePtr>& args,
+                             Analyzer& analyzer) {
+    if (args.empty()) return Analyzer::constant(ValuePtr::fromBool(true));
+
+    std::vector<NodePtr> nodes;
+    for (auto& arg : args) nodes.push_back(analyzer.analyze(arg));
+
+    return makeNode([nodes](EvalEnv& env, TailCall* tail) {
+        for (std::size_t i = 0; i != nodes.size() - 1; ++i) {
+            if (Value::isVirtual(nodes[i]->exec(env)))
+                return ValuePtr::fromBool(false);
         }
-    }
-    return std::make_shared<BooleanValue>(true);
+        return nodes.back()->exec(env, tail);
+    });
 }
 
-ValuePtr SpecialForm::orForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
-    if (!args.empty()) {
-        for (auto& arg : args) {
-            auto val = env.eval(arg);
-            if (Value::isVirtual(val)) continue;
-            return val;
+NodePtr SpecialForm::orForm(const std::vector<ValuePtr>& args,
+                            Analyzer& analyzer) {
+    if (args.empty()) return Analyzer::constant(ValuePtr::fromBool(false));
+
+    std::vector<NodePtr> nodes;
+    for (auto& arg : args) nodes.push_back(analyzer.analyze(arg));
+
+    return makeNode([nodes](EvalEnv& env, TailCall* tail) {
+        for (std::size_t i = 0; i != nodes.size() - 1; ++i) {
+            auto val = nodes[i]->exec(env);
+            if (!Value::isVirtual(val)) return val;
         }
-    }
-    return std::make_shared<BooleanValue>(false);
+        return nodes.back()->exec(env, tail);
+    });
 }
 
-ValuePtr SpecialForm::condForm(const std::vector<ValuePtr>& args,
-                               EvalEnv& env) {
+NodePtr SpecialForm::condForm(const std::vector<ValuePtr>& args,
+                              Analyzer& analyzer) {
+    struct Clause {
+        NodePtr cond;  // null for else
+        NodePtr body;  // null if the clause is just a test
+    };
+
+    std::vector<Clause> clauses;
     for (std::size_t i = 0; i != args.size(); ++i) {
         auto clause = vectorize(args[i]);
-        ValuePtr cond;
-        if (clause[0]->toString() == "else") {
+        checkArgNum(clause, 1);
+
+        NodePtr cond;
+        if (clause[0].toString() == "else") {
             if (i != args.size() - 1)
                 throw LispError(
                     "Bad syntax: else clause must appear at the end");
-            cond = std::make_shared<BooleanValue>(true);
         } else
-            cond = env.eval(clause[0]);
-        if (Value::isVirtual(cond)) continue;
-        if (clause.size() == 1) return cond;
-        for (std::size_t j = 1; j != clause.size(); ++j) {
-            if (j == clause.size() - 1) return env.eval(clause[j]);
-            env.eval(clause[j]);
-        }
+            cond = analyzer.analyze(clause[0]);
+
+        NodePtr body;
+        if (clause.size() > 1)
+            body = analyzer.analyzeSequence({clause.begin() + 1, clause.end()});
+        clauses.push_back({cond, body});
     }
-    return std::make_shared<NilValue>();
+
+    return makeNode([clauses](EvalEnv& env, TailCall* tail) {
+        for (auto& clause : clauses) {
+            auto cond = clause.cond ? clause.cond->exec(env)
+                                    : ValuePtr::fromBool(true);
+            if (Value::isVirtual(cond)) continue;
+            if (!clause.body) return cond;
+            return clause.body->exec(env, tail);
+        }
+        return ValuePtr::nil();
+    });
 }
 
-ValuePtr SpecialForm::beginForm(const std::vector<ValuePtr>& args,
-                                EvalEnv& env) {
+NodePtr SpecialForm::beginForm(const std::vector<ValuePtr>& args,
+                               Analyzer& analyzer) {
     checkArgNum(args, 1);
-    for (std::size_t i = 0; i != args.size(); ++i) {
-        auto val = env.eval(args[i]);
-        if (i == args.size() - 1) return env.eval(args[i]);
-    }
-    return std::make_shared<NilValue>();
+    return analyzer.analyzeSequence(args);
 }
 
-ValuePtr SpecialForm::letForm(const std::vector<ValuePtr>& args, EvalEnv& env) {
+NodePtr SpecialForm::letForm(const std::vector<ValuePtr>& args,
+                             Analyzer& analyzer) {
     checkArgNum(args, 2);
 
-    auto param_list = vectorize(args[0]);
-    std::vector<std::string> names;
-    std::vector<ValuePtr> values;
-
-    for (auto& bind : param_list) {
+    std::vector<SymbolId> names;
+    std::vector<NodePtr> inits;
+    for (auto& bind : vectorize(args[0])) {
         auto bind_vec = vectorize(bind);
         checkArgNum(bind_vec, 2, 2);
 
-        names.push_back(bind_vec[0]->asSymbol());
-
-        values.push_back(env.eval(bind_vec[1]));
+        names.push_back(bind_vec[0].asSymbolId());
+        inits.push_back(analyzer.analyze(bind_vec[1]));
     }
-    std::vector<ValuePtr> body(args.begin() + 1, args.end());
-    auto lambda =
-        std::make_shared<LambdaValue>(names, body, env.shared_from_this());
-    return lambda->apply(values);
+    auto [scope, body] =
+        analyzer.analyzeScope(names, {args.begin() + 1, args.end()});
+
+    return makeNode([inits, scope = Pinned(scope), body = body](
+                        EvalEnv& env, TailCall* tail) {
+        ArgBuffer values;
+        for (auto& init : inits) values.push(init->exec(env));
+
+        auto frame = env.createChild(scope, values.args());
+        Pinned pinned_frame{ValuePtr(frame)};
+        return body->exec(*frame, tail);
+    });
 }
 
-ValuePtr SpecialForm::quoteForm(const std::vector<ValuePtr>& args,
-                                EvalEnv& env) {
-    return args[0];
+NodePtr SpecialForm::quoteForm(const std::vector<ValuePtr>& args,
+                               Analyzer& analyzer) {
+    checkArgNum(args, 1, 1);
+    return Analyzer::constant(args[0]);
 }
 
-ValuePtr SpecialForm::quasiquoteForm(const std::vector<ValuePtr>& args,
-                                     EvalEnv& env) {
-    if (!Value::isList(args[0])) return args[0];
-
-    auto quoted = args[0]->toVector();
-    if (Value::isSymbol(quoted[0]) && quoted[0]->asSymbol() == "unquote")
-        return env.eval(quoted[1]);
-
-    for (auto& expr : quoted) {
-        if (Value::isList(expr) &&
-            expr->toVector()[0]->asSymbol() == "unquote") {
-            expr = env.eval(expr->toVector()[1]);
-        }
+NodePtr SpecialForm::quasiquoteForm(const std::vector<ValuePtr>& args,
+                                    Analyzer& analyzer) {
+    checkArgNum(args, 1, 1);
+    if (!Value::isPair(args[0]) || !Value::isList(args[0]))
+        return Analyzer::constant(args[0]);
+    if (isUnquote(args[0]))
+        return analyzer.analyze(args[0].toVector()[1]);
+
+    // only the unquoted elements are evaluated, the rest is copied as is
+    std::vector<NodePtr> nodes;
+    for (auto& expr : args[0].toVector()) {
+        nodes.push_back(isUnquote(expr)
+                            ? analyzer.analyze(expr.toVector()[1])
+                            : Analyzer::constant(expr));
     }
-    return Value::makeList(quoted);
+
+    return makeNode([nodes](EvalEnv& env, TailCall*) {
+        ArgBuffer quoted;
+        for (auto& node : nodes) quoted.push(node->exec(env));
+        return Value::makeList(quoted.take());
+    });
 }
 
-ValuePtr SpecialForm::unquoteForm(const std::vector<ValuePtr>& args,
-                                  EvalEnv& env) {
+NodePtr SpecialForm::unquoteForm(const std::vector<ValuePtr>& args,
+                                 Analyzer& analyzer) {
     throw LispError("Cannot call unquote form outside quasiquote form");
 }
 
 // extra
 
-ValuePtr SpecialForm::loadForm(const std::vector<ValuePtr>& args,
-                               EvalEnv& env) {
+NodePtr SpecialForm::loadForm(const std::vector<ValuePtr>& args,
+                              Analyzer& analyzer) {
     checkArgNum(args, 1, 1);
 
-    std::string filename = args[0]->asString();
-    fileMode(filename);
-    return std::make_shared<NilValue>();
+    std::string filename{args[0].asString()};
+    return makeNode([filename](EvalEnv& env, TailCall*) {
+        fileMode(filename);
+        return ValuePtr::nil();
+    });
 }
 
-ValuePtr SpecialForm::readForm(const std::vector<ValuePtr>& args,
-                               EvalEnv& env) {
+NodePtr SpecialForm::readForm(const std::vector<ValuePtr>& args,
+                              Analyzer& analyzer) {
     checkArgNum(args, 0, 0);
 
-    return readParse(std::cin);
+    return makeNode(
+        [](EvalEnv& env, TailCall*) { return readParse(std::cin); });
 }
 
-ValuePtr SpecialForm::readLineForm(const std::vector<ValuePtr>& args,
-                                   EvalEnv& env) {
-    return std::make_shared<StringValue>(readForm(args, env)->toString());
+NodePtr SpecialForm::readLineForm(const std::vector<ValuePtr>& args,
+                                  Analyzer& analyzer) {
+    auto read = readForm(args, analyzer);
+    return makeNode([read](EvalEnv& env, TailCall*) {
+        return StringValue::from(read->exec(env).toString());
+    });
 }
 
-ValuePtr SpecialForm::readEvalForm(const std::vector<ValuePtr>& args,
-                                   EvalEnv& env) {
+NodePtr SpecialForm::readEvalForm(const std::vector<ValuePtr>& args,
+                                  Analyzer& analyzer) {
     checkArgNum(args, 0, 0);
 
-    return env.eval(readParse(std::cin));
+    return makeNode(
+        [](EvalEnv& env, TailCall*) { return env.eval(readParse(std::cin)); });
 }
 
-ValuePtr SpecialForm::assertForm(const std::vector<ValuePtr>& args,
-                                 EvalEnv& env) {
+NodePtr SpecialForm::assertForm(const std::vector<ValuePtr>& args,
+                                Analyzer& analyzer) {
     checkArgNum(args, 1, 2);
 
-    ValuePtr val = env.eval(args[0]);
+    Pinned expr{args[0]};
+    auto node = analyzer.analyze(expr);
     std::string msg = "";
-    if (args.size() == 2) msg = args[1]->asString();
+    if (args.size() == 2) msg = args[1].asString();
 
-    if (Value::isVirtual(val)) {
-        std::cerr << "Assertion failed: (assert " + args[0]->toString() + ")"
-                  << std::endl;
-        if (msg != "") std::cerr << "Message: " + msg << std::endl;
-        throw TestFailure(msg);
-    } else
-        return std::make_shared<BooleanValue>(true);
+    return makeNode([expr, node, msg](EvalEnv& env, TailCall*) {
+        ValuePtr val = node->exec(env);
+        if (Value::isVirtual(val)) {
+            std::cerr << "Assertion failed: (assert " +
+                             expr.get().toString() + ")"
+                      << std::endl;
+            if (msg != "") std::cerr << "Message: " + msg << std::endl;
+            throw TestFailure(msg);
+        } else
+            return ValuePtr::fromBool(true);
+    });
 }
 
-ValuePtr SpecialForm::assertTrueForm(const std::vector<ValuePtr>& args,
-                                     EvalEnv& env) {
+NodePtr SpecialForm::assertTrueForm(const std::vector<ValuePtr>& args,
+                                    Analyzer& analyzer) {
     checkArgNum(args, 1, 2);
 
-    ValuePtr val = env.eval(args[0]);
-    bool is_true = val->asBool();
+    Pinned expr{args[0]};
+    auto node = analyzer.analyze(expr);
     std::string msg = "";
-    if (args.size() == 2) msg = args[1]->asString();
+    if (args.size() == 2) msg = args[1].asString();
 
-    if (!is_true) {
-        std::cerr << "Assertion failed: (assert-true " + args[0]->toString() +
-                         ")"
-                  << std::endl;
-        if (msg != "") std::cerr << "Message: " + msg << std::endl;
-        throw TestFailure(msg);
-    } else
-        return std::make_shared<BooleanValue>(true);
+    return makeNode([expr, node, msg](EvalEnv& env, TailCall*) {
+        bool is_true = node->exec(env).asBool();
+        if (!is_true) {
+            std::cerr << "Assertion failed: (assert-true " +
+                             expr.get().toString() + ")"
+                      << std::endl;
+            if (msg != "") std::cerr << "Message: " + msg << std::endl;
+            throw TestFailure(msg);
+        } else
+            return ValuePtr::fromBool(true);
+    });
 }
 
-ValuePtr SpecialForm::checkErrorForm(const std::vector<ValuePtr>& args,
-                                     EvalEnv& env) {
+NodePtr SpecialForm::checkErrorForm(const std::vector<ValuePtr>& args,
+                                    Analyzer& analyzer) {
     checkArgNum(args, 1, 2);
 
+    Pinned expr{args[0]};
+    auto node = analyzer.analyze(expr);
     std::string msg = "";
-    if (args.size() == 2) msg = args[1]->asString();
+    if (args.size() == 2) msg = args[1].asString();
 
-    try {
-        ValuePtr val = env.eval(args[0]);
-        std::cerr << "Check-error failed: (check-error " + args[0]->toString() +
-                         ")"
-                  << std::endl;
-        if (msg != "") std::cerr << "Message: " + msg << std::endl;
-    } catch (Error& e) {
-        return std::make_shared<BooleanValue>(true);
-    }
-    throw TestFailure(msg);
+    return makeNode([expr, node, msg](EvalEnv& env, TailCall*) {
+        try {
+            node->exec(env);
+            std::cerr << "Check-error failed: (check-error " +
+                             expr.get().toString() + ")"
+                      << std::endl;
+            if (msg != "") std::cerr << "Message: " + msg << std::endl;
+        } catch (Error& e) {
+            return ValuePtr::fromBool(true);
+        }
+        throw TestFailure(msg);
+    });
 }
 
-ValuePtr SpecialForm::defineTestForm(const std::vector<ValuePtr>& args,
-                                     EvalEnv& env) {
+NodePtr SpecialForm::defineTestForm(const std::vector<ValuePtr>& args,
+                                    Analyzer& analyzer) {
     checkArgNum(args, 2);
 
     std::vector<ValuePtr> lambda_args{args};
     lambda_args[0] = Value::makeList({});
-    auto test = lambdaForm(lambda_args, env);
-    auto test_sym =
-        std::make_shared<SymbolValue>(args[0]->toString() + "@TEST");
-    env.defineBinding(test_sym, test);
-    return quoteForm({args[0]}, env);
+    auto test = lambdaForm(lambda_args, analyzer);
+    auto test_sym = SymbolValue::intern(args[0].toString() + "@TEST");
+    auto define = defineNode(test_sym, test, analyzer);
+
+    return makeNode([define, name = Pinned(args[0])](EvalEnv& env,
+                                                     TailCall*) {
+        define->exec(env);
+        return name.get();
+    });
 }
 
-ValuePtr SpecialForm::runTestForm(const std::vector<ValuePtr>& args,
-                                  EvalEnv& env) {
+NodePtr SpecialForm::runTestForm(const std::vector<ValuePtr>& args,
+                                 Analyzer& analyzer) {
     checkArgNum(args, 1);
-    for (auto& test : args) {
-        try {
-            std::cout << "Running test: " << test->toString() << std::endl;
-            auto test_sym =
-                std::make_shared<SymbolValue>(test->toString() + "@TEST");
-            env.eval(Value::makeList({test_sym}));
-            std::cout << "Test passed\n" << std::endl;
-        } catch (Error& e) {
-            e.handle();
-            std::cout << "Test failed: " << test->toString() + "\n"
-                      << std::endl;
+    std::vector<Pinned> tests{args.begin(), args.end()};
+    return makeNode([tests](EvalEnv& env, TailCall*) {
+        for (const ValuePtr& test : tests) {
+            try {
+                std::cout << "Running test: " << test.toString() << std::endl;
+                auto test_sym =
+                    SymbolValue::intern(test.toString() + "@TEST");
+                env.eval(Value::makeList({test_sym}));
+                std::cout << "Test passed\n" << std::endl;
+            } catch (Error& e) {
+                e.handle();
+                std::cout << "Test failed: " << test.toString() + "\n"
+                          << std::endl;
+            }
         }
-    }
-    return std::make_shared<NilValue>();
+        return ValuePtr::nil();
+    });
 }
 
-ValuePtr SpecialForm::runAllTestsForm(const std::vector<ValuePtr>& args,
-                                      EvalEnv& env) {
+NodePtr SpecialForm::runAllTestsForm(const std::vector<ValuePtr>& args,
+                                     Analyzer& analyzer) {
     checkArgNum(args, 0, 0);
-    auto tests = env.getAllTestsName();
-    int passed = 0;
-    for (auto& test : tests) {
-        auto test_name = test->toString().substr(0, test->toString().find("@"));
-        try {
+    return makeNode([](EvalEnv& env, TailCall*) {
+        auto tests = env.getAllTestsName();
+        int passed = 0;
+        for (auto& test : tests) {
             auto test_name =
-                test->toString().substr(0, test->toString().find("@"));
-            std::cout << "Running test: " << test_name << std::endl;
-            env.eval(Value::makeList({test}));
-            passed++;
-            std::cout << "Test passed\n" << std::endl;
-        } catch (Error& e) {
-            e.handle();
-            std::cout << "Test failed: " << test_name + "\n" << std::endl;
+                test.toString().substr(0, test.toString().find("@"));
+            try {
+                std::cout << "Running test: " << test_name << std::endl;
+                env.eval(Value::makeList({test}));
+                passed++;
+                std::cout << "Test passed\n" << std::endl;
+            } catch (Error& e) {
+                e.handle();
+                std::cout << "Test failed: " << test_name + "\n" << std::endl;
+            }
         }
-    }
-    std::cout << "Tests passed: " + std::to_string(passed) + "/" +
-                     std::to_string(tests.size())
-              << std::endl;
-    return std::make_shared<NilValue>();
+        std::cout << "Tests passed: " + std::to_string(passed) + "/" +
+                         std::to_string(tests.size())
+                  << std::endl;
+        return ValuePtr::nil();
+    });
 }
 
 extern const std::unordered_map<std::string, SpecialFormType*>
@@ -1,13 +1,12 @@
 #ifndef FORMS_H
 #define FORMS_H
 
+#include "./analyzer.h"
 #include "./builtins.h"
 #include "./eval_env.h"
 
-using SpecialFormType = ValuePtr(const std::vector<ValuePtr>&, EvalEnv&);
-
 namespace SpecialForm {
-using Builtins::checkArgNum, Builtins::numericalize, Builtins::vectorize;
+using Builtins::checkArgNum, Builtins::vectorize;
 
 SpecialFormType defineForm;
 SpecialFormType lambdaForm;
@@ -33,6 +32,11 @@ SpecialFormType defineTestForm;
 SpecialFormType runTestForm;
 SpecialFormType runAllTestsForm;
 
+// special form heading `expr`, or nullptr
+SpecialFormType* formOf(const ValuePtr& expr);
+// true iff `expr` is (unquote x)
+bool isUnquote(const ValuePtr& expr);
+
 extern const std::unordered_map<std::string, SpecialFormType*> form_list;
 };  // namespace SpecialForm
 
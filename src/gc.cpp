@@ -0,0 +1,311 @@
+#include "./gc.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <string>
+
+#include "./error.h"
+#include "./eval_env.h"
+
+// A slab is SIZE bytes aligned on SIZE, so the slab of a cell is found by
+// masking its address. Its header records which cells hold a value.
+struct Heap::Slab {
+    static constexpr std::size_t SIZE = 1 << 16;
+    static constexpr std::size_t HEADER = 1 << 10;  // the fields below
+    static constexpr std::size_t MAX_CELLS = (SIZE - HEADER) / 8;
+
+    std::size_t cell_size;
+    std::uint64_t live[(MAX_CELLS + 63) / 64];
+
+    explicit Slab(std::size_t cell_size) : cell_size{cell_size}, live{} {}
+
+    static Slab* of(const void* cell) {
+        return reinterpret_cast<Slab*>(reinterpret_cast<std::uintptr_t>(cell) &
+                                       ~(SIZE - 1));
+    }
+    std::size_t cellCount() const {
+        return (SIZE - HEADER) / cell_size;
+    }
+    Value* cell(std::size_t i) {
+        return reinterpret_cast<Value*>(reinterpret_cast<std::byte*>(this) +
+                                        HEADER + i * cell_size);
+    }
+    std::size_t indexOf(const void* cell) const {
+        auto offset = static_cast<const std::byte*>(cell) -
+                      reinterpret_cast<const std::byte*>(this);
+        return (static_cast<std::size_t>(offset) - HEADER) / cell_size;
+    }
+    bool isLive(std::size_t i) const {
+        return live[i / 64] >> (i % 64) & 1;
+    }
+    void setLive(std::size_t i, bool is_live) {
+        if (is_live)
+            live[i / 64] |= std::uint64_t{1} << (i % 64);
+        else
+            live[i / 64] &= ~(std::uint64_t{1} << (i % 64));
+    }
+};
+
+void* Value::allocate(std::size_t size) {
+    return Heap::instance().allocate(size);
+}
+
+void Value::deallocate(void* cell, std::size_t size) {
+    Heap::instance().deallocate(cell, size);
+}
+
+void Value::track(Value* obj) {
+    Heap::instance().track(obj);
+}
+
+void* Value::allocateImmortal(std::size_t size, std::size_t align) {
+    // outlives static destructors, which may still use immortals
+    static auto& arena = *new std::pmr::monotonic_buffer_resource;
+    return arena.allocate(size, align);
+}
+
+void Tracer::mark(Value* obj) {
+    if (!obj || obj->marked || (obj->old && !major)) return;
+    obj->marked = true;
+    gray.push_back(obj);
+}
+
+Heap& Heap::instance() {
+    static constinit Heap heap;
+    return heap;
+}
+
+void Heap::grow(Pool& pool, std::size_t cell_size) {
+    static_assert(sizeof(Slab) <= Slab::HEADER);
+    if (max_heap != 0 && size() + Slab::SIZE > max_heap) outOfMemory();
+    heap_bytes += Slab::SIZE;
+    auto memory = ::operator new(Slab::SIZE, std::align_val_t{Slab::SIZE});
+    auto slab = new (memory) Slab(cell_size);
+    pool.slabs.push_back(slab);
+    for (auto i = slab->cellCount(); i-- != 0;) {
+        auto cell = reinterpret_cast<FreeCell*>(slab->cell(i));
+        cell->next = pool.free;
+        pool.free = cell;
+    }
+}
+
+void Heap::outOfMemory() {
+    soft_limit = 0;  // collect at the next safepoint
+    throw LispError("Out of memory: heap limit of " +
+                    std::to_string(max_heap) + " bytes exceeded");
+}
+
+void Heap::reserve(std::size_t bytes) {
+    if (max_heap != 0 && bytes > max_heap - std::min(size(), max_heap))
+        outOfMemory();
+}
+
+void Heap::track(Value* obj) {
+    auto slab = Slab::of(obj);
+    slab->setLive(slab->indexOf(obj), true);
+    young.push_back(obj);
+
+    auto type = static_cast<std::size_t>(obj->getType());
+    ++counters.objects[type];
+    counters.bytes[type] += slab->cell_size;
+}
+
+void Heap::destroy(Value* obj) {
+    switch (obj->getType()) {
+        case ValueType::NUMERIC:
+            static_cast<BigIntValue*>(obj)->~BigIntValue();
+            break;
+        case ValueType::STRING:
+            static_cast<StringValue*>(obj)->~StringValue();
+            break;
+        case ValueType::PAIR: static_cast<PairValue*>(obj)->~PairValue(); break;
+        case ValueType::VECTOR:
+            static_cast<VectorValue*>(obj)->~VectorValue();
+            break;
+        case ValueType::F64VECTOR:
+            static_cast<F64VectorValue*>(obj)->~F64VectorValue();
+            break;
+        case ValueType::BUILTIN_PROC:
+            static_cast<BuiltinProcValue*>(obj)->~BuiltinProcValue();
+            break;
+        case ValueType::LAMBDA:
+            static_cast<LambdaValue*>(obj)->~LambdaValue();
+            break;
+        case ValueType::SCOPE:
+            static_cast<ScopeValue*>(obj)->~ScopeValue();
+            break;
+        case ValueType::ENVIRONMENT:
+            static_cast<EvalEnv*>(obj)->~EvalEnv();
+            break;
+        default: break;  // other immediates and symbols are never allocated
+    }
+}
+
+void Heap::release(Value* obj) {
+    auto slab = Slab::of(obj);
+    destroy(obj);
+    slab->setLive(slab->indexOf(obj), false);
+    auto cell = reinterpret_cast<FreeCell*>(obj);
+    auto& pool = pools[slab->cell_size / 8 - 1];
+    cell->next = pool.free;
+    pool.free = cell;
+}
+
+void Heap::traceChildren(Value* obj, Tracer& tracer) {
+    switch (obj->getType()) {
+        case ValueType::STRING:
+            static_cast<StringValue*>(obj)->trace(tracer);
+            break;
+        case ValueType::PAIR:
+            static_cast<PairValue*>(obj)->trace(tracer);
+            break;
+        case ValueType::VECTOR:
+            static_cast<VectorValue*>(obj)->trace(tracer);
+            break;
+        case ValueType::LAMBDA:
+            static_cast<LambdaValue*>(obj)->trace(tracer);
+            break;
+        case ValueType::ENVIRONMENT:
+            static_cast<EvalEnv*>(obj)->trace(tracer);
+            break;
+        default: break;  // no references to other values
+    }
+}
+
+void Heap::remember(Value* obj) {
+    obj->remembered = true;
+    remembered.push_back(obj);
+}
+
+// In both sweeps, destroying a lambda may unpin constants of its body; they
+// were marked as pinned, so they survive until the next collection.
+void Heap::sweepYoung() {
+    for (auto obj : young) {
+        if (obj->marked) {
+            obj->marked = false;
+            obj->old = true;
+            ++old_count;
+        } else {
+            release(obj);
+        }
+    }
+    young.clear();
+}
+
+void Heap::sweepAll() {
+    old_count = 0;
+    for (auto& pool : pools) {
+        // free cells are threaded anew, in address order, so allocation
+        // fills the slabs front to back
+        FreeCell* free = nullptr;
+        auto tail = &free;
+        std::erase_if(pool.slabs, [&](Slab* slab) {
+            std::size_t live = 0;
+            for (std::size_t i = 0; i != slab->cellCount(); ++i) {
+                if (!slab->isLive(i)) continue;
+                auto obj = slab->cell(i);
+                if (obj->marked) {
+                    obj->marked = false;
+                    obj->old = true;
+                    ++live;
+                } else {
+                    destroy(obj);
+                    slab->setLive(i, false);
+                }
+            }
+            if (live == 0) {
+                slab->~Slab();
+                ::operator delete(slab, std::align_val_t{Slab::SIZE});
+                heap_bytes -= Slab::SIZE;
+                return true;
+            }
+
+            old_count += live;
+            for (std::size_t i = 0; i != slab->cellCount(); ++i) {
+                if (slab->isLive(i)) continue;
+                auto cell = reinterpret_cast<FreeCell*>(slab->cell(i));
+                *tail = cell;
+                tail = &cell->next;
+            }
+            return false;
+        });
+        *tail = nullptr;
+        pool.free = free;
+    }
+    young.clear();
+}
+
+void Heap::collect(bool major) {
+    std::vector<Value*> gray;
+    Tracer tracer{gray, major};
+
+    if (major) {
+        for (auto& pool : pools)
+            for (auto slab : pool.slabs)
+                for (std::size_t i = 0; i != slab->cellCount(); ++i)
+                    if (slab->isLive(i) && slab->cell(i)->pins != 0)
+                        tracer.mark(slab->cell(i));
+    } else {
+        for (auto obj : young)
+            if (obj->pins != 0) tracer.mark(obj);
+        // every other old value points to old values only
+        for (auto obj : remembered) traceChildren(obj, tracer);
+    }
+    EvalStack::instance().trace(tracer);
+    for (auto scope = scopes; scope != nullptr; scope = scope->next)
+        scope->trace(tracer);
+
+    while (!gray.empty()) {
+        auto obj = gray.back();
+        gray.pop_back();
+        traceChildren(obj, tracer);
+    }
+
+    // no young values are left to point to
+    for (auto obj : remembered) obj->remembered = false;
+    remembered.clear();
+
+    if (major) {
+        sweepAll();
+        old_threshold = std::max(MIN_OLD_THRESHOLD, 2 * old_count);
+        ++counters.major_collections;
+    } else {
+        sweepYoung();
+        ++counters.minor_collections;
+    }
+    updateSoftLimit();
+}
+
+void Heap::updateSoftLimit() {
+    // collect again once half the remaining headroom is used
+    if (max_heap == 0)
+        soft_limit = SIZE_MAX;
+    else
+        soft_limit = size() + (max_heap - std::min(size(), max_heap)) / 2;
+}
+
+void Heap::setLimit(std::size_t bytes) {
+    max_heap = bytes / Slab::SIZE * Slab::SIZE;
+    if (bytes != 0 && max_heap == 0) max_heap = Slab::SIZE;
+    updateSoftLimit();
+}
+
+void ListBuilder::push(ValuePtr val) {
+    auto pair = Value::make<PairValue>(val, ValuePtr::nil());
+    if (last) {
+        Heap::instance().writeBarrier(last, pair);
+        last->r_part = pair;
+    } else {
+        head = pair;
+    }
+    last = pair.cast<PairValue>();
+}
+
+ValuePtr ListBuilder::finish(ValuePtr tail) {
+    if (!last) return tail;
+    Heap::instance().writeBarrier(last, tail);
+    last->r_part = tail;
+    return head;
+}
@@ -0,0 +1,237 @@
+#ifndef GC_H
+#define GC_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "./value.h"
+
+// Marks values reachable from the roots. Marked values are queued rather
+// than traced recursively, so long lists do not exhaust the C++ stack. A
+// minor collection leaves old values alone.
+class Tracer {
+private:
+    std::vector<Value*>& gray;
+    bool major;
+
+public:
+    Tracer(std::vector<Value*>& gray, bool major) : gray{gray}, major{major} {}
+    void mark(Value* obj);
+    void mark(const ValuePtr& val) {
+        mark(val.get());
+    }
+};
+
+class RootScope;
+
+// Allocation counters of the Heap, since the interpreter started.
+struct HeapStats {
+    std::array<std::size_t, VALUE_TYPE_COUNT> objects{};  // by ValueType
+    std::array<std::size_t, VALUE_TYPE_COUNT> bytes{};    // cells they took
+    std::size_t minor_collections{0};
+    std::size_t major_collections{0};
+};
+
+// Precise generational mark-and-sweep collector owning every Value but the
+// immortal ones, call frames included. It only runs at safepoints, where
+// every live value is reachable from a root: a pinned value, the EvalStack
+// or a RootScope.
+//
+// New values are young. A minor collection traces young values only, from
+// the roots and the old values remembered by the write barrier, and
+// promotes the survivors to the old generation in place: C++ code holds
+// frames and values by address across calls, so nothing is ever moved. Old
+// values are only reclaimed by a major collection of the whole heap.
+//
+// Values live in pools of equal-size cells, one pool per multiple of 8
+// bytes, carved out of slabs: objects of a kind sit side by side, and a
+// pair takes 24 bytes with no allocator overhead.
+//
+// The heap may be given a budget, covering the slabs and the storage values
+// hold outside them (the elements of vectors, the characters of strings,
+// the limbs of bignums). Approaching it makes safepoints collect the whole
+// heap; exceeding it makes the allocation throw a LispError.
+class Heap {
+    friend class RootScope;
+
+private:
+    static constexpr std::size_t NURSERY_SIZE = 1 << 15;
+    static constexpr std::size_t MIN_OLD_THRESHOLD = 1 << 16;
+
+    struct Slab;
+    struct FreeCell {
+        FreeCell* next;
+    };
+    struct Pool {
+        FreeCell* free{nullptr};  // in address order after a major collection
+        std::vector<Slab*> slabs;
+    };
+
+    std::array<Pool, Value::MAX_SIZE / 8> pools;
+    std::vector<Value*> young;  // allocated since the last collection
+    std::size_t old_count{0};
+    std::size_t old_threshold{MIN_OLD_THRESHOLD};  // for a major collection
+    std::vector<Value*> remembered;  // old values that may point to young
+    RootScope* scopes{nullptr};      // innermost first
+
+    std::size_t heap_bytes{0};      // in slabs
+    std::size_t external_bytes{0};  // held by values outside the slabs
+    std::size_t max_heap{0};    // 0 for no limit
+    std::size_t soft_limit{SIZE_MAX};  // for a major collection
+    HeapStats counters;
+
+    constexpr Heap() = default;
+    void grow(Pool& pool, std::size_t cell_size);
+    static void destroy(Value* obj);
+    void release(Value* obj);  // destroys it and frees its cell
+    void traceChildren(Value* obj, Tracer& tracer);
+    void remember(Value* obj);
+    void sweepYoung();
+    void sweepAll();
+    void updateSoftLimit();
+    [[noreturn]] void outOfMemory();
+
+public:
+    static Heap& instance();
+
+    // a cell for an object of `size` bytes, which track() must be given
+    // once the object is constructed in it
+    void* allocate(std::size_t size) {
+        auto& pool = pools[(size + 7) / 8 - 1];
+        if (!pool.free) grow(pool, (size + 7) / 8 * 8);
+        auto cell = pool.free;
+        pool.free = cell->next;
+        return cell;
+    }
+    // gives back a cell from allocate() that no object was constructed in
+    void deallocate(void* cell, std::size_t size) {
+        auto& pool = pools[(size + 7) / 8 - 1];
+        auto free = static_cast<FreeCell*>(cell);
+        free->next = pool.free;
+        pool.free = free;
+    }
+    void track(Value* obj);
+    // a pinned value is a root until it is unpinned as often
+    static void pin(Value* obj) {
+        ++obj->pins;
+    }
+    static void unpin(Value* obj) {
+        --obj->pins;
+    }
+
+    // Write barrier, for every store of `val` into a field of an existing
+    // value `owner` (in practice, only environments, vectors and the lists
+    // of a ListBuilder are ever mutated).
+    void writeBarrier(Value* owner, const ValuePtr& val) {
+        auto obj = val.get();
+        if (owner->old && !owner->remembered && obj && !obj->old)
+            remember(owner);
+    }
+
+    // Reached by the evaluator on entering a procedure, once its frame is
+    // rooted: collects when the nursery is full, the whole heap if the old
+    // generation doubled since the last major collection or the budget is
+    // close.
+    void safepoint() {
+        if (young.size() >= NURSERY_SIZE || size() > soft_limit)
+            collect(old_count >= old_threshold || size() > soft_limit);
+    }
+    void collect(bool major);
+
+    // Storage a value holds outside its cell. reserve() throws, as a full
+    // heap does, unless `bytes` more fit in the budget: it is called before
+    // allocating storage of a size the program chose. Values then account
+    // for what they hold on construction, which throws the same way, and
+    // destruction.
+    void reserve(std::size_t bytes);
+    void addExternal(std::size_t bytes) {
+        reserve(bytes);
+        external_bytes += bytes;
+    }
+    void removeExternal(std::size_t bytes) {
+        external_bytes -= bytes;
+    }
+
+    // limits the heap to `bytes` (rounded down to whole slabs), 0 for none
+    void setLimit(std::size_t bytes);
+    std::size_t size() const {
+        return heap_bytes + external_bytes;
+    }
+    const HeapStats& stats() const {
+        return counters;
+    }
+};
+
+// Handle keeping a value, and all it references, alive for as long as it
+// exists: for values held where the collector cannot see them, such as the
+// constants of analyzed code or the frame a procedure runs in.
+class Pinned {
+private:
+    ValuePtr val;
+
+public:
+    Pinned(ValuePtr val = ValuePtr::nil()) : val{val} {
+        if (auto obj = val.get()) Heap::pin(obj);
+    }
+    Pinned(const Pinned& other) : Pinned(other.val) {}
+    Pinned& operator=(const Pinned& other) {
+        Pinned copy{other};
+        std::swap(val, copy.val);
+        return *this;
+    }
+    ~Pinned() {
+        if (auto obj = val.get()) Heap::unpin(obj);
+    }
+
+    const ValuePtr& get() const {
+        return val;
+    }
+    operator const ValuePtr&() const {
+        return val;
+    }
+};
+
+// Base of C++ structures holding values the collector cannot see, e.g. the
+// operand stack of the VM: the Heap traces them while the scope is alive.
+// Scopes must end in the reverse order they began.
+class RootScope {
+    friend class Heap;
+
+private:
+    RootScope* next;
+
+public:
+    RootScope() : next{Heap::instance().scopes} {
+        Heap::instance().scopes = this;
+    }
+    RootScope(const RootScope&) = delete;
+    RootScope& operator=(const RootScope&) = delete;
+    virtual ~RootScope() {
+        Heap::instance().scopes = next;
+    }
+
+    virtual void trace(Tracer& tracer) const = 0;
+};
+
+// Builds a list front to back in linear time, appending to its last pair.
+// The list built so far is a root, so its elements may be computed by code
+// that collects, e.g. procedures called by map.
+class ListBuilder : public RootScope {
+private:
+    ValuePtr head;
+    PairValue* last{nullptr};
+
+public:
+    void push(ValuePtr val);
+    // the list, ending in `tail`; the builder is spent
+    ValuePtr finish(ValuePtr tail = ValuePtr::nil());
+
+    void trace(Tracer& tracer) const override {
+        tracer.mark(head);
+    }
+};
+
+#endif
@@ -1,7 +1,12 @@
+#include <charconv>
+#include <cstddef>
 #include <iostream>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "./boot.h"
+#include "./error.h"
 #include "./eval_env.h"
 #include "./parser.h"
 #include "./tokenizer.h"
@@ -10,26 +15,54 @@
 
 struct TestCtx {
     std::string eval(std::string input) {
-        auto tokens = Tokenizer::tokenize(input);
-        Parser parser(std::move(tokens));
-        auto value = parser.parse();
-        static auto env = EvalEnv::createGlobal();
-        auto result = env->eval(std::move(value));
-        return result->toString();
+        try {
+            return evaluate(input).toString();
+        } catch (const LispError& e) {
+            // the Heap cases check that the budget is enforced
+            if (std::string_view{e.what()}.starts_with("Out of memory"))
+                return "out-of-memory";
+            throw;
+        }
     }
 };
 
 int test() {
-    RJSJ_TEST(TestCtx, Lv2, Lv3, Lv4, Lv5, Lv5Extra, Lv6, Lv7, Lv7Lib, Sicp);
+    setMaxHeap(64 << 20);
+    RJSJ_TEST(TestCtx, Lv2, Lv3, Lv4, Lv5, Lv5Extra, Lv6, Lv7, Lv7Lib, Sicp,
+              Bignum, F64Vector, Vector, String, Heap);
     return 0;
 }
 
 int main(int argc, char **argv) {
+    std::vector<std::string> args(argv + 1, argv + argc);
+    const std::string max_heap = "--max-heap=";
+    while (!args.empty() && args.front().starts_with("--")) {
+        auto& option = args.front();
+        if (option == "--vm") {
+            setVMMode(true);
+        } else if (option.starts_with(max_heap)) {
+            // digits only: no sign, no unit, nothing after them
+            auto first = option.data() + max_heap.size();
+            auto last = option.data() + option.size();
+            std::size_t bytes = 0;
+            auto [end, ec] = std::from_chars(first, last, bytes);
+            if (ec != std::errc{} || end != last) {
+                std::cerr << "Error: Invalid heap size " << option << std::endl;
+                return 1;
+            }
+            setMaxHeap(bytes);
+        } else {
+            std::cerr << "Error: Unknown option " << option << std::endl;
+            return 1;
+        }
+        args.erase(args.begin());
+    }
+
     // return test();
 
-    switch (argc) {
-        case 1: REPLMode(); break;
-        case 2: fileMode(argv[1]); break;
+    switch (args.size()) {
+        case 0: REPLMode(); break;
+        case 1: fileMode(args[0]); break;
         default: std::cerr << "Error: Invalid arguments" << std::endl;
     }
 }
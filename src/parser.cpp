@@ -1,52 +1,62 @@
 #include "./parser.h"
 
 #include "./error.h"
+#include "./gc.h"
 
 ValuePtr Parser::parse() {
-    if (this->tokens.empty()) throw SyntaxError("Unexpected end of file");
+    if (tokens.empty()) throw SyntaxError("Unexpected end of file");
 
-    auto token = std::move(this->tokens.front());
-    tokens.pop_front();
+    auto& token = tokens.front();
+    tokens.pop();
 
-    if (token->getType() == TokenType::NUMERIC_LITERAL) {
-        auto value = static_cast<NumericLiteralToken&>(*token).getValue();
-        return std::make_shared<NumericValue>(value);
+    if (token.getType() == TokenType::NUMERIC_LITERAL) {
+        auto& number = static_cast<const NumericLiteralToken&>(token);
+        if (number.isExact()) return *parseInteger(number.getDigits());
+        return ValuePtr::fromNumber(number.getValue());
     }
 
-    if (token->getType() == TokenType::BOOLEAN_LITERAL) {
-        auto value = static_cast<BooleanLiteralToken&>(*token).getValue();
-        return std::make_shared<BooleanValue>(value);
+    if (token.getType() == TokenType::BOOLEAN_LITERAL) {
+        auto value = static_cast<const BooleanLiteralToken&>(token).getValue();
+        return ValuePtr::fromBool(value);
     }
 
-    if (token->getType() == TokenType::STRING_LITERAL) {
-        auto value = static_cast<StringLiteralToken&>(*token).getValue();
-        return std::make_shared<StringValue>(value);
+    if (token.getType() == TokenType::STRING_LITERAL) {
+        auto value = static_cast<const StringLiteralToken&>(token).getValue();
+        return StringValue::from(std::string(value));
     }
 
-    if (token->getType() == TokenType::IDENTIFIER) {
-        auto value = static_cast<IdentifierToken&>(*token).getName();
-        return std::make_shared<SymbolValue>(value);
+    if (token.getType() == TokenType::IDENTIFIER) {
+        auto value = static_cast<const IdentifierToken&>(token).getName();
+        return SymbolValue::intern(value);
     }
 
-    if (token->getType() == TokenType::LEFT_PAREN) {
+    if (token.getType() == TokenType::LEFT_PAREN) {
         auto value = parseTails();
         return value;
     }
 
-    if (token->getType() == TokenType::QUOTE) {
-        auto quote = std::make_shared<SymbolValue>("quote");
+    if (token.getType() == TokenType::VECTOR_PAREN) {
+        // read as a list, which keeps the elements rooted meanwhile
+        auto elements = parseTails();
+        if (!Value::isList(elements))
+            throw SyntaxError("Unexpected . in vector literal");
+        return Value::make<VectorValue>(elements.toVector());
+    }
+
+    if (token.getType() == TokenType::QUOTE) {
+        auto quote = SymbolValue::intern("quote");
         auto value = parse();
         return Value::makeList({quote, value});
     }
 
-    if (token->getType() == TokenType::QUASIQUOTE) {
-        auto quasiquote = std::make_shared<SymbolValue>("quasiquote");
+    if (token.getType() == TokenType::QUASIQUOTE) {
+        auto quasiquote = SymbolValue::intern("quasiquote");
         auto value = parse();
         return Value::makeList({quasiquote, value});
     }
 
-    if (token->getType() == TokenType::UNQUOTE) {
-        auto unquote = std::make_shared<SymbolValue>("unquote");
+    if (token.getType() == TokenType::UNQUOTE) {
+        auto unquote = SymbolValue::intern("unquote");
         auto value = parse();
         return Value::makeList({unquote, value});
     }
@@ -55,27 +65,28 @@ ValuePtr Parser::parse() {
 }
 
 ValuePtr Parser::parseTails() {
-    if (tokens.size() == 0)
-        throw SyntaxError("Unexpected end of file");
+    // elements are read in a loop, so only nesting takes C++ stack
+    ListBuilder list;
+    while (true) {
+        if (tokens.empty())
+            throw SyntaxError("Unexpected end of file");
 
-    if (tokens.front()->getType() == TokenType::RIGHT_PAREN) {
-        tokens.pop_front();
-        return std::make_shared<NilValue>();
-    }
-    auto car = parse();
-    if (tokens.size() == 0) throw SyntaxError("Unexpected end of file");
-    if (tokens.front()->getType() == TokenType::DOT) {
-        tokens.pop_front();
-        if (tokens.size() == 0) throw SyntaxError("Unexpected end of file");
-        auto cdr = parse();
-        if (tokens.size() == 0) throw SyntaxError("Unexpected end of file");
-        if (tokens.front()->getType() != TokenType::RIGHT_PAREN) {
-            throw SyntaxError("Expected exactly one element after .");
+        if (tokens.front().getType() == TokenType::RIGHT_PAREN) {
+            tokens.pop();
+            return list.finish();
+        }
+        list.push(parse());
+        if (tokens.empty()) throw SyntaxError("Unexpected end of file");
+        if (tokens.front().getType() == TokenType::DOT) {
+            tokens.pop();
+            if (tokens.empty()) throw SyntaxError("Unexpected end of file");
+            auto cdr = parse();
+            if (tokens.empty()) throw SyntaxError("Unexpected end of file");
+            if (tokens.front().getType() != TokenType::RIGHT_PAREN) {
+                throw SyntaxError("Expected exactly one element after .");
+            }
+            tokens.pop();
+            return list.finish(cdr);
         }
-        tokens.pop_front();
-        return std::make_shared<PairValue>(car, cdr);
-    } else {
-        auto cdr = parseTails();
-        return std::make_shared<PairValue>(car, cdr);
     }
 }
\ No newline at end of file
@@ -1129,6 +1129,129 @@ RMLT_CASE("(define (len s) (if (eq? s '()) 0 (+ 1 (len (cdr s)))))")
 RMLT_CASE("(len '(1 2 3 4))", "4")
 RMLT_END_CASES()
 
+RMLT_BEGIN_CASES(Bignum)
+RMLT_CASE("(number->string (+ 999999999999999999 1))", "\"1000000000000000000\"")
+RMLT_CASE("(number->string (- 1000000000000000000 1))", "\"999999999999999999\"")
+RMLT_CASE("(number->string (- 1 1000000000000000000000000000))", "\"-999999999999999999999999999\"")
+RMLT_CASE("(= (- (+ 140737488355327 1) 1) 140737488355327)", "#t")
+RMLT_CASE("(integer? (* 140737488355327 140737488355327))", "#t")
+RMLT_CASE("(number->string (* 123456789012345678901234567890 987654321098765432109876543210))", "\"121932631137021795226185032733622923332237463801111263526900\"")
+RMLT_CASE("(define a (expt 3 1000))")
+RMLT_CASE("(define b (expt 7 700))")
+RMLT_CASE("(string-length (number->string a))", "478")
+RMLT_CASE("(= (modulo (* a b) 1000000007) 545803490)", "#t")
+RMLT_CASE("(= (quotient (* a b) b) a)", "#t")
+RMLT_CASE("(= (* (+ a b) (- a b)) (- (* a a) (* b b)))", "#t")
+RMLT_CASE("(string-length (number->string (* a a)))", "955")
+RMLT_CASE("(= (modulo (* a a) 1000000007) 480151387)", "#t")
+RMLT_CASE("(= (* (expt 3 50000) (expt 3 50000)) (expt 3 100000))", "#t")
+RMLT_CASE("(number->string (quotient (expt 10 40) 7))", "\"1428571428571428571428571428571428571428\"")
+RMLT_CASE("(number->string (quotient (- (expt 10 40)) 7))", "\"-1428571428571428571428571428571428571428\"")
+RMLT_CASE("(remainder (expt 10 40) 7)", "4")
+RMLT_CASE("(remainder (- (expt 10 40)) 7)", "-4")
+RMLT_CASE("(modulo (- (expt 10 40)) 7)", "3")
+RMLT_CASE("(= (remainder (expt 10 40) (expt 10 20)) 0)", "#t")
+RMLT_CASE("(expt 7 1000000000)", "out-of-memory")
+RMLT_CASE("(expt a 100000000)", "out-of-memory")
+RMLT_CASE("(expt -1 1000000000001)", "-1")
+RMLT_END_CASES()
+
+// lengths around the register widths, so every kernel runs its tail too
+RMLT_BEGIN_CASES(F64Vector)
+RMLT_CASE("(define (iota n) (if (= n 0) '() (append (iota (- n 1)) (list n))))")
+RMLT_CASE("(define (check n) (if (= n 0) #t (let ((w (list->f64vector (iota n)))) (if (and (= (f64vector-sum w) (reduce + (iota n))) (= (f64vector-dot w w) (reduce + (map (lambda (x) (* x x)) (iota n))))) (check (- n 1)) n))))")
+RMLT_CASE("(check 40)", "#t")
+RMLT_CASE("(define v (list->f64vector (map (lambda (i) (* i 0.5)) (iota 37))))")
+RMLT_CASE("(f64vector-length v)", "37")
+RMLT_CASE("(f64vector-sum v)", "351.5")
+RMLT_CASE("(f64vector-dot v v)", "4393.75")
+RMLT_CASE("(define u (list->f64vector (map (lambda (i) (/ i 10)) (iota 29))))")
+RMLT_CASE("(f64vector-sum u)", "43.5")
+RMLT_CASE("(f64vector-dot u u)", "85.55")
+RMLT_CASE("(f64vector-min (f64vector 3 1 4 1 5 9 2 6 -5))", "-5")
+RMLT_CASE("(f64vector-max (f64vector 3 1 4 1 5 9 2 6 -5))", "9")
+RMLT_CASE("(f64vector-min (f64vector 7))", "7")
+RMLT_CASE("(f64vector->list (f64vector-map+ (f64vector 1 2 3) (f64vector 10 20 30)))", "(11 22 33)")
+RMLT_CASE("(f64vector->list (f64vector-scale (f64vector 1 2 3 4 5) 2))", "(2 4 6 8 10)")
+RMLT_CASE("(define w (make-f64vector 5 1.5))")
+RMLT_CASE("(f64vector-set! w 4 2.5)")
+RMLT_CASE("(f64vector-ref w 4)", "2.5")
+RMLT_CASE("(f64vector-sum w)", "8.5")
+RMLT_CASE("(f64vector? (f64vector))", "#t")
+RMLT_CASE("(f64vector? (vector 1))", "#f")
+RMLT_END_CASES()
+
+// a vector is printed inside a list, where the elements of #(...) still
+// take part in the comparison
+RMLT_BEGIN_CASES(Vector)
+RMLT_CASE("(vector->list #(1 \"a\" (2 3) #t))", "(1 \"a\" (2 3) #t)")
+RMLT_CASE("(list #(1 2 3))", "(#(1 2 3))")
+RMLT_CASE("(list #())", "(#())")
+RMLT_CASE("(list #(#(1) ()))", "(#(#(1) ()))")
+RMLT_CASE("(vector-ref '#(1 2) 1)", "2")
+RMLT_CASE("(vector-ref #((+ 1 2)) 0)", "(+ 1 2)")
+RMLT_CASE("(vector? #(1))", "#t")
+RMLT_CASE("(vector? '(1))", "#f")
+RMLT_CASE("(define v (make-vector 3 'a))")
+RMLT_CASE("(vector-set! v 1 'b)")
+RMLT_CASE("(list v)", "(#(a b a))")
+RMLT_CASE("(vector-fill! v 0)")
+RMLT_CASE("(vector->list v)", "(0 0 0)")
+RMLT_CASE("(vector-ref (list->vector '(1 2 3)) 2)", "3")
+RMLT_CASE("(vector-length (vector))", "0")
+RMLT_CASE("(vector-length (vector 1 2 3 4))", "4")
+// an old vector set to young values keeps them through collections
+RMLT_CASE("(define old (make-vector 2 0))")
+RMLT_CASE("(define (churn n) (if (= n 0) 'done (begin (cons 1 2) (churn (- n 1)))))")
+RMLT_CASE("(churn 100000)", "done")
+RMLT_CASE("(vector-set! old 0 (list 1 2 3))")
+RMLT_CASE("(churn 100000)", "done")
+RMLT_CASE("(vector-ref old 0)", "(1 2 3)")
+RMLT_END_CASES()
+
+// strings long enough to be shared as ropes and slices
+RMLT_BEGIN_CASES(String)
+RMLT_CASE("(define long (string-append (make-string 70 \"a\") (make-string 70 \"b\")))")
+RMLT_CASE("(string-length long)", "140")
+RMLT_CASE("(string-ref long 69)", "\"a\"")
+RMLT_CASE("(string-ref long 70)", "\"b\"")
+RMLT_CASE("(substring long 60 20)", "\"aaaaaaaaaabbbbbbbbbb\"")
+RMLT_CASE("(substring long 130)", "\"bbbbbbbbbb\"")
+RMLT_CASE("(define slice (substring long 5 130))")
+RMLT_CASE("(string-length slice)", "130")
+RMLT_CASE("(string-ref slice 64)", "\"a\"")
+RMLT_CASE("(string-ref slice 65)", "\"b\"")
+RMLT_CASE("(substring slice 60 10)", "\"aaaaabbbbb\"")
+RMLT_CASE("(string-length (string-copy slice))", "130")
+RMLT_CASE("(define inner (substring (substring long 1 138) 1 136))")
+RMLT_CASE("(string-length inner)", "136")
+RMLT_CASE("(string-ref inner 67)", "\"a\"")
+RMLT_CASE("(string-ref inner 68)", "\"b\"")
+RMLT_CASE("(equal? (string-append \"abc\" (make-string 70 \"d\")) (string-append \"ab\" (string-append \"c\" (make-string 70 \"d\"))))", "#t")
+RMLT_CASE("(define (build s n) (if (= n 0) s (build (string-append s \"ab\") (- n 1))))")
+RMLT_CASE("(define built (build \"\" 100000))")
+RMLT_CASE("(string-length built)", "200000")
+RMLT_CASE("(string-ref built 199999)", "\"b\"")
+RMLT_CASE("(substring built 1990 4)", "\"abab\"")
+RMLT_END_CASES()
+
+// run under the budget set by test(); running out of memory evaluates to
+// out-of-memory
+RMLT_BEGIN_CASES(Heap)
+RMLT_CASE("(make-vector 100000000000 0)", "out-of-memory")
+RMLT_CASE("(make-f64vector 100000000000 0)", "out-of-memory")
+RMLT_CASE("(make-string 100000000000)", "out-of-memory")
+RMLT_CASE("(vector-length (make-vector 1000 0))", "1000")
+RMLT_CASE("(define (grow v n) (if (= n 0) (vector-length v) (grow (list->vector (append (vector->list v) (vector->list v))) (- n 1))))")
+RMLT_CASE("(grow #(1) 10)", "1024")
+RMLT_CASE("(grow #(1) 40)", "out-of-memory")
+RMLT_CASE("(define (double s n) (if (= n 0) s (double (string-append s s) (- n 1))))")
+RMLT_CASE("(string-length (double \"ab\" 40))", "2199023255552")
+RMLT_CASE("(string-ref (double \"ab\" 40) 1)", "out-of-memory")
+RMLT_CASE("(string-ref (double \"ab\" 10) 1)", "\"b\"")
+RMLT_CASE("'ok", "ok")
+RMLT_END_CASES()
+
 #undef RMLT_BEGIN_CASES
 #undef RMLT_CASE
 #undef RMLT_END_CASES
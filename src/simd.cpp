@@ -0,0 +1,275 @@
+#include "./simd.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || \
+    defined(_M_IX86)
+#define SIMD_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// SSE2 is part of every x86-64 target, so it needs no check at run time
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2
+#endif
+
+// GCC and Clang compile a single function for AVX on request, MSVC always
+// accepts its intrinsics
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SIMD_AVX_TARGET
+#else
+#define SIMD_AVX_TARGET __attribute__((target("avx")))
+#endif
+
+namespace {
+// one implementation of each kernel, on raw arrays of `n` doubles
+struct Kernels {
+    double (*sum)(const double* xs, std::size_t n);
+    double (*dot)(const double* xs, const double* ys, std::size_t n);
+    void (*add)(const double* xs, const double* ys, double* out,
+                std::size_t n);
+    void (*scale)(const double* xs, double factor, double* out,
+                  std::size_t n);
+    double (*min)(const double* xs, std::size_t n);
+    double (*max)(const double* xs, std::size_t n);
+};
+
+namespace scalar {
+double sum(const double* xs, std::size_t n) {
+    double total = 0;
+    for (std::size_t i = 0; i != n; ++i) total += xs[i];
+    return total;
+}
+
+double dot(const double* xs, const double* ys, std::size_t n) {
+    double total = 0;
+    for (std::size_t i = 0; i != n; ++i) total += xs[i] * ys[i];
+    return total;
+}
+
+void add(const double* xs, const double* ys, double* out, std::size_t n) {
+    for (std::size_t i = 0; i != n; ++i) out[i] = xs[i] + ys[i];
+}
+
+void scale(const double* xs, double factor, double* out, std::size_t n) {
+    for (std::size_t i = 0; i != n; ++i) out[i] = xs[i] * factor;
+}
+
+double min(const double* xs, std::size_t n) {
+    double res = xs[0];
+    for (std::size_t i = 1; i != n; ++i) res = xs[i] < res ? xs[i] : res;
+    return res;
+}
+
+double max(const double* xs, std::size_t n) {
+    double res = xs[0];
+    for (std::size_t i = 1; i != n; ++i) res = xs[i] > res ? xs[i] : res;
+    return res;
+}
+}  // namespace scalar
+
+#ifdef SIMD_SSE2
+// Two lanes per register. Sums keep two registers of partial sums, so
+// consecutive additions do not wait on each other; the elements past the
+// last full register are left to the scalar kernels.
+namespace sse2 {
+double horizontalSum(__m128d v) {
+    return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+}
+
+double sum(const double* xs, std::size_t n) {
+    auto acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(acc0, _mm_loadu_pd(xs + i));
+        acc1 = _mm_add_pd(acc1, _mm_loadu_pd(xs + i + 2));
+    }
+    return horizontalSum(_mm_add_pd(acc0, acc1)) + scalar::sum(xs + i, n - i);
+}
+
+double dot(const double* xs, const double* ys, std::size_t n) {
+    auto acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 = _mm_add_pd(
+            acc0, _mm_mul_pd(_mm_loadu_pd(xs + i), _mm_loadu_pd(ys + i)));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(xs + i + 2),
+                                           _mm_loadu_pd(ys + i + 2)));
+    }
+    return horizontalSum(_mm_add_pd(acc0, acc1)) +
+           scalar::dot(xs + i, ys + i, n - i);
+}
+
+void add(const double* xs, const double* ys, double* out, std::size_t n) {
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(out + i,
+                      _mm_add_pd(_mm_loadu_pd(xs + i), _mm_loadu_pd(ys + i)));
+    scalar::add(xs + i, ys + i, out + i, n - i);
+}
+
+void scale(const double* xs, double factor, double* out, std::size_t n) {
+    auto factors = _mm_set1_pd(factor);
+    std::size_t i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(xs + i), factors));
+    scalar::scale(xs + i, factor, out + i, n - i);
+}
+
+// min and max are idempotent, so the last register may overlap the others
+double min(const double* xs, std::size_t n) {
+    if (n < 2) return scalar::min(xs, n);
+    auto acc = _mm_loadu_pd(xs);
+    for (std::size_t i = 2; i + 2 <= n; i += 2)
+        acc = _mm_min_pd(acc, _mm_loadu_pd(xs + i));
+    acc = _mm_min_pd(acc, _mm_loadu_pd(xs + n - 2));
+    return _mm_cvtsd_f64(_mm_min_sd(acc, _mm_unpackhi_pd(acc, acc)));
+}
+
+double max(const double* xs, std::size_t n) {
+    if (n < 2) return scalar::max(xs, n);
+    auto acc = _mm_loadu_pd(xs);
+    for (std::size_t i = 2; i + 2 <= n; i += 2)
+        acc = _mm_max_pd(acc, _mm_loadu_pd(xs + i));
+    acc = _mm_max_pd(acc, _mm_loadu_pd(xs + n - 2));
+    return _mm_cvtsd_f64(_mm_max_sd(acc, _mm_unpackhi_pd(acc, acc)));
+}
+}  // namespace sse2
+#endif
+
+#ifdef SIMD_X86
+// Four lanes per register, the same way as SSE2.
+namespace avx {
+SIMD_AVX_TARGET double horizontalSum(__m256d v) {
+    auto halves = _mm_add_pd(_mm256_castpd256_pd128(v),
+                             _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(halves, _mm_unpackhi_pd(halves, halves)));
+}
+
+SIMD_AVX_TARGET double sum(const double* xs, std::size_t n) {
+    auto acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(xs + i));
+        acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(xs + i + 4));
+    }
+    return horizontalSum(_mm256_add_pd(acc0, acc1)) +
+           scalar::sum(xs + i, n - i);
+}
+
+SIMD_AVX_TARGET double dot(const double* xs, const double* ys,
+                           std::size_t n) {
+    auto acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(xs + i),
+                                                 _mm256_loadu_pd(ys + i)));
+        acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(xs + i + 4),
+                                                 _mm256_loadu_pd(ys + i + 4)));
+    }
+    return horizontalSum(_mm256_add_pd(acc0, acc1)) +
+           scalar::dot(xs + i, ys + i, n - i);
+}
+
+SIMD_AVX_TARGET void add(const double* xs, const double* ys, double* out,
+                         std::size_t n) {
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_loadu_pd(xs + i),
+                                                _mm256_loadu_pd(ys + i)));
+    scalar::add(xs + i, ys + i, out + i, n - i);
+}
+
+SIMD_AVX_TARGET void scale(const double* xs, double factor, double* out,
+                           std::size_t n) {
+    auto factors = _mm256_set1_pd(factor);
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(out + i,
+                         _mm256_mul_pd(_mm256_loadu_pd(xs + i), factors));
+    scalar::scale(xs + i, factor, out + i, n - i);
+}
+
+SIMD_AVX_TARGET double min(const double* xs, std::size_t n) {
+    if (n < 4) return scalar::min(xs, n);
+    auto acc = _mm256_loadu_pd(xs);
+    for (std::size_t i = 4; i + 4 <= n; i += 4)
+        acc = _mm256_min_pd(acc, _mm256_loadu_pd(xs + i));
+    acc = _mm256_min_pd(acc, _mm256_loadu_pd(xs + n - 4));
+    auto halves = _mm_min_pd(_mm256_castpd256_pd128(acc),
+                             _mm256_extractf128_pd(acc, 1));
+    return _mm_cvtsd_f64(_mm_min_sd(halves, _mm_unpackhi_pd(halves, halves)));
+}
+
+SIMD_AVX_TARGET double max(const double* xs, std::size_t n) {
+    if (n < 4) return scalar::max(xs, n);
+    auto acc = _mm256_loadu_pd(xs);
+    for (std::size_t i = 4; i + 4 <= n; i += 4)
+        acc = _mm256_max_pd(acc, _mm256_loadu_pd(xs + i));
+    acc = _mm256_max_pd(acc, _mm256_loadu_pd(xs + n - 4));
+    auto halves = _mm_max_pd(_mm256_castpd256_pd128(acc),
+                             _mm256_extractf128_pd(acc, 1));
+    return _mm_cvtsd_f64(_mm_max_sd(halves, _mm_unpackhi_pd(halves, halves)));
+}
+
+// the CPU has AVX, and the OS saves its registers
+bool hasAvx() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = info[2] & (1 << 27), avx = info[2] & (1 << 28);
+    return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+    return __builtin_cpu_supports("avx");
+#endif
+}
+}  // namespace avx
+#endif
+
+// chosen once, on first use
+const Kernels& kernels() {
+    static const Kernels chosen = [] {
+#ifdef SIMD_X86
+        if (avx::hasAvx())
+            return Kernels{avx::sum,   avx::dot, avx::add,
+                           avx::scale, avx::min, avx::max};
+#endif
+#ifdef SIMD_SSE2
+        return Kernels{sse2::sum,   sse2::dot, sse2::add,
+                       sse2::scale, sse2::min, sse2::max};
+#else
+        return Kernels{scalar::sum,   scalar::dot, scalar::add,
+                       scalar::scale, scalar::min, scalar::max};
+#endif
+    }();
+    return chosen;
+}
+}  // namespace
+
+double Simd::sum(std::span<const double> xs) {
+    return kernels().sum(xs.data(), xs.size());
+}
+
+double Simd::dot(std::span<const double> xs, std::span<const double> ys) {
+    return kernels().dot(xs.data(), ys.data(), xs.size());
+}
+
+void Simd::add(std::span<const double> xs, std::span<const double> ys,
+               std::span<double> out) {
+    kernels().add(xs.data(), ys.data(), out.data(), xs.size());
+}
+
+void Simd::scale(std::span<const double> xs, double factor,
+                 std::span<double> out) {
+    kernels().scale(xs.data(), factor, out.data(), xs.size());
+}
+
+double Simd::min(std::span<const double> xs) {
+    return kernels().min(xs.data(), xs.size());
+}
+
+double Simd::max(std::span<const double> xs) {
+    return kernels().max(xs.data(), xs.size());
+}
@@ -0,0 +1,27 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+#include <span>
+
+// Kernels over arrays of doubles, for f64vectors. Each has an AVX version
+// picked at run time when the CPU supports it, an SSE2 one where it is part
+// of the target, and a portable scalar one otherwise. Sums are not taken
+// strictly left to right, so they may round differently from a loop.
+namespace Simd {
+
+double sum(std::span<const double> xs);
+// of two arrays of the same length
+double dot(std::span<const double> xs, std::span<const double> ys);
+// `out` = `xs` + `ys`, element-wise; all three of the same length
+void add(std::span<const double> xs, std::span<const double> ys,
+         std::span<double> out);
+// `out` = `xs` * `factor`; `out` as long as `xs`
+void scale(std::span<const double> xs, double factor, std::span<double> out);
+// of a nonempty array; which NaN element, if any, is unspecified
+double min(std::span<const double> xs);
+double max(std::span<const double> xs);
+
+}  // namespace Simd
+
+#endif
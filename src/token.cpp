@@ -5,7 +5,7 @@
 
 using namespace std::literals;
 
-TokenPtr Token::fromChar(char c) {
+TokenPtr Token::fromChar(char c, TokenList& list) {
     TokenType type;
     switch (c) {
         case '(':
@@ -27,16 +27,25 @@ TokenPtr Token::fromChar(char c) {
         default:
             return nullptr;
     }
-    return TokenPtr(new Token(type));
+    return list.make<Token>(type);
 }
 
-TokenPtr Token::dot() { return TokenPtr(new Token(TokenType::DOT)); }
+TokenPtr Token::dot(TokenList& list) {
+    return list.make<Token>(TokenType::DOT);
+}
+
+TokenPtr Token::vectorParen(TokenList& list) {
+    return list.make<Token>(TokenType::VECTOR_PAREN);
+}
 
 std::string Token::toString() const {
     switch (type) {
         case TokenType::LEFT_PAREN:
             return "(LEFT_PAREN)";
             break;
+        case TokenType::VECTOR_PAREN:
+            return "(VECTOR_PAREN)";
+            break;
         case TokenType::RIGHT_PAREN:
             return "(RIGHT_PAREN)";
             break;
@@ -57,11 +66,11 @@ std::string Token::toString() const {
     }
 }
 
-std::unique_ptr<BooleanLiteralToken> BooleanLiteralToken::fromChar(char c) {
+TokenPtr BooleanLiteralToken::fromChar(char c, TokenList& list) {
     if (c == 't') {
-        return std::make_unique<BooleanLiteralToken>(true);
+        return list.make<BooleanLiteralToken>(true);
     } else if (c == 'f') {
-        return std::make_unique<BooleanLiteralToken>(false);
+        return list.make<BooleanLiteralToken>(false);
     } else {
         return nullptr;
     }
@@ -72,7 +81,8 @@ std::string BooleanLiteralToken::toString() const {
 }
 
 std::string NumericLiteralToken::toString() const {
-    return "(NUMERIC_LITERAL " + std::to_string(value) + ")";
+    return "(NUMERIC_LITERAL " +
+           (exact ? std::string(digits) : std::to_string(value)) + ")";
 }
 
 std::string StringLiteralToken::toString() const {
@@ -82,9 +92,15 @@ std::string StringLiteralToken::toString() const {
 }
 
 std::string IdentifierToken::toString() const {
-    return "(IDENTIFIER " + name + ")";
+    return "(IDENTIFIER " + std::string(name) + ")";
 }
 
 std::ostream& operator<<(std::ostream& os, const Token& token) {
     return os << token.toString();
 }
+
+std::string_view TokenList::copy(std::string_view text) {
+    auto chars = static_cast<char*>(arena.allocate(text.size(), 1));
+    text.copy(chars, text.size());
+    return {chars, text.size()};
+}
@@ -1,11 +1,18 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include <array>
+#include <cstddef>
+#include <memory_resource>
+#include <new>
 #include <string>
-#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 enum class TokenType {
     LEFT_PAREN,
+    VECTOR_PAREN,  // #(
     RIGHT_PAREN,
     QUOTE,
     QUASIQUOTE,
@@ -18,9 +25,12 @@ enum class TokenType {
 };
 
 class Token;
-using TokenPtr = std::unique_ptr<Token>;
+class TokenList;
+using TokenPtr = const Token*;  // owned by the TokenList it was read into
 
 class Token {
+    friend class TokenList;
+
 private:
     TokenType type;
 
@@ -30,8 +40,9 @@ protected:
 public:
     virtual ~Token() = default;
 
-    static TokenPtr fromChar(char c);
-    static TokenPtr dot();
+    static TokenPtr fromChar(char c, TokenList& list);
+    static TokenPtr dot(TokenList& list);
+    static TokenPtr vectorParen(TokenList& list);
 
     TokenType getType() const { return type; }
     virtual std::string toString() const;
@@ -45,48 +56,93 @@ public:
     BooleanLiteralToken(bool value)
         : Token(TokenType::BOOLEAN_LITERAL), value{value} {}
 
-    static std::unique_ptr<BooleanLiteralToken> fromChar(char c);
+    static TokenPtr fromChar(char c, TokenList& list);
 
     bool getValue() const { return value; }
     std::string toString() const override;
 };
 
+// An exact integer literal keeps its digits, of any length, for the parser
+// to read; others keep their value.
 class NumericLiteralToken : public Token {
 private:
-    double value;
+    double value{0};
+    std::string_view digits;
+    bool exact{false};
 
 public:
     NumericLiteralToken(double value)
         : Token(TokenType::NUMERIC_LITERAL), value{value} {}
+    NumericLiteralToken(std::string_view digits)
+        : Token(TokenType::NUMERIC_LITERAL), digits{digits}, exact{true} {}
 
     double getValue() const { return value; }
+    bool isExact() const { return exact; }
+    std::string_view getDigits() const { return digits; }
     std::string toString() const override;
 };
 
 class StringLiteralToken : public Token {
 private:
-    std::string value;
+    std::string_view value;
 
 public:
-    StringLiteralToken(const std::string& value)
+    StringLiteralToken(std::string_view value)
         : Token(TokenType::STRING_LITERAL), value{value} {}
 
-    const std::string& getValue() const { return value; }
+    std::string_view getValue() const { return value; }
     std::string toString() const override;
 };
 
 class IdentifierToken : public Token {
 private:
-    std::string name;
+    std::string_view name;
 
 public:
-    IdentifierToken(const std::string& name)
+    IdentifierToken(std::string_view name)
         : Token(TokenType::IDENTIFIER), name{name} {}
 
-    const std::string& getName() const { return name; }
+    std::string_view getName() const { return name; }
     std::string toString() const override;
 };
 
 std::ostream& operator<<(std::ostream& os, const Token& token);
 
+// Tokens of one top-level read. They and their text are allocated in an
+// arena released in one shot with the list, so tokens own nothing and are
+// never destroyed one by one. Short reads fit in the inline buffer.
+class TokenList {
+private:
+    std::array<std::byte, 2048> buffer;
+    std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size()};
+    std::pmr::vector<TokenPtr> tokens{&arena};
+    std::size_t next{0};  // first token not consumed yet
+
+public:
+    TokenList() = default;
+    TokenList(const TokenList&) = delete;
+    TokenList& operator=(const TokenList&) = delete;
+
+    template <typename T, typename... Args>
+    TokenPtr make(Args&&... args) {
+        return new (arena.allocate(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+    }
+    // copy of `text` living as long as the list
+    std::string_view copy(std::string_view text);
+
+    void push(TokenPtr token) {
+        tokens.push_back(token);
+    }
+    bool empty() const {
+        return next == tokens.size();
+    }
+    const Token& front() const {
+        return *tokens[next];
+    }
+    void pop() {
+        ++next;
+    }
+};
+
 #endif
@@ -2,8 +2,11 @@
 
 #include <cctype>
 #include <set>
+#include <string_view>
 
+#include "./bigint.h"
 #include "./error.h"
+#include "./value.h"
 
 const std::set<char> TOKEN_END{'(', ')', '\'', '`', ',', '"'};
 
@@ -16,23 +19,29 @@ TokenPtr Tokenizer::nextToken(int& pos) {
             }
         } else if (std::isspace(c)) {
             pos++;
-        } else if (auto token = Token::fromChar(c)) {
+        } else if (auto token = Token::fromChar(c, tokens)) {
             pos++;
             return token;
         } else if (c == '#') {
-            if (auto result = BooleanLiteralToken::fromChar(input[pos + 1])) {
+            if (input[pos + 1] == '(') {
+                pos += 2;
+                return Token::vectorParen(tokens);
+            } else if (auto result = BooleanLiteralToken::fromChar(
+                           input[pos + 1], tokens)) {
                 pos += 2;
                 return result;
             } else {
                 throw SyntaxError("Unexpected character after #");
             }
         } else if (c == '"') {
-            std::string string;
+            auto& string = unescaped;
+            string.clear();
             pos++;
             while (pos < input.size()) {
                 if (input[pos] == '"') {
                     pos++;
-                    return std::make_unique<StringLiteralToken>(string);
+                    return tokens.make<StringLiteralToken>(
+                        tokens.copy(string));
                 } else if (input[pos] == '\\') {
                     if (pos + 1 >= input.size()) {
                         throw SyntaxError("Unexpected end of string literal");
@@ -56,37 +65,34 @@ TokenPtr Tokenizer::nextToken(int& pos) {
                 pos++;
             } while (pos < input.size() && !std::isspace(input[pos]) &&
                      !TOKEN_END.contains(input[pos]));
-            auto text = input.substr(start, pos - start);
+            auto text = std::string_view(input).substr(start, pos - start);
             if (text == ".") {
-                return Token::dot();
+                return Token::dot(tokens);
             }
             if (std::isdigit(text[0]) || text[0] == '+' || text[0] == '-' ||
                 text[0] == '.') {
-                try {
-                    return std::make_unique<NumericLiteralToken>(
-                        std::stod(text));
-                } catch (std::invalid_argument& e) {
-                }
+                if (BigInt::isDecimal(text))
+                    return tokens.make<NumericLiteralToken>(tokens.copy(text));
+                if (auto value = parseReal(text))
+                    return tokens.make<NumericLiteralToken>(*value);
             }
-            return std::make_unique<IdentifierToken>(text);
+            return tokens.make<IdentifierToken>(tokens.copy(text));
         }
     }
     return nullptr;
 }
 
-std::deque<TokenPtr> Tokenizer::tokenize() {
-    std::deque<TokenPtr> tokens;
+void Tokenizer::tokenize() {
     int pos = 0;
     while (true) {
         auto token = nextToken(pos);
         if (!token) {
             break;
         }
-        tokens.push_back(std::move(token));
+        tokens.push(token);
     }
-    return tokens;
 }
 
-std::deque<TokenPtr> Tokenizer::tokenize(const std::string& input) {
-    return Tokenizer(input).tokenize();
+void Tokenizer::tokenize(const std::string& input, TokenList& tokens) {
+    Tokenizer(input, tokens).tokenize();
 }
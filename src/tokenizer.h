@@ -1,20 +1,24 @@
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
-#include <deque>
+#include <string>
 
 #include "./token.h"
 
 class Tokenizer {
 private:
     TokenPtr nextToken(int& pos);
-    std::deque<TokenPtr> tokenize();
+    void tokenize();
 
-    std::string input;
-    Tokenizer(const std::string& input) : input{input} {}
+    const std::string& input;
+    TokenList& tokens;
+    std::string unescaped;  // string literal being read
+    Tokenizer(const std::string& input, TokenList& tokens)
+        : input{input}, tokens{tokens} {}
 
 public:
-    static std::deque<TokenPtr> tokenize(const std::string& input);
+    // appends the tokens of `input` to `tokens`
+    static void tokenize(const std::string& input, TokenList& tokens);
 };
 
 #endif
\ No newline at end of file
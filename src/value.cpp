@@ -1,184 +1,462 @@
 #include "./value.h"
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
 #include <iomanip>
 #include <iostream>  // debug
 #include <sstream>
+#include <string_view>
+#include <unordered_map>
 
 #include "./error.h"
 #include "./eval_env.h"
+#include "./forms.h"
+#include "./gc.h"
+
+namespace {
+// from_chars() takes no plus sign
+std::string_view withoutPlus(std::string_view text) {
+    return text.starts_with('+') && !text.starts_with("+-") ? text.substr(1)
+                                                            : text;
+}
 
-Value::~Value() {}
+// the power of ten of the leading digit of a nonzero decimal `text`
+std::int64_t orderOfMagnitude(std::string_view text) {
+    std::int64_t exponent = 0;
+    if (auto e = text.find_first_of("eE"); e != text.npos) {
+        auto digits = withoutPlus(text.substr(e + 1));
+        auto end = digits.data() + digits.size();
+        auto [ptr, ec] = std::from_chars(digits.data(), end, exponent);
+        if (ec == std::errc::result_out_of_range)
+            exponent = digits.starts_with('-') ? INT32_MIN : INT32_MAX;
+        text = text.substr(0, e);
+    }
+    auto point = std::min(text.find('.'), text.size());
+    auto first = std::min(text.find_first_of("123456789"), text.size());
+    return exponent + (first < point ? std::int64_t(point - first) - 1
+                                     : -std::int64_t(first - point));
+}
+
+// shortest text reading back as the same double; integral values print
+// without a fraction or an exponent while they are exact
+std::string formatReal(double value) {
+    std::array<char, 32> buf;
+    auto first = buf.data(), last = buf.data() + buf.size();
+    auto [end, ec] =
+        std::fmod(value, 1.0) == 0.0 && std::abs(value) < 0x1p53
+            ? std::to_chars(first, last, value, std::chars_format::fixed)
+            : std::to_chars(first, last, value);
+    return std::string(first, end);
+}
+}  // namespace
+
+std::string ValuePtr::toString() const {
+    switch (getType()) {
+        case ValueType::NUMERIC: {
+            if (isFixnum()) return std::to_string(fixnum());
+            if (auto big = cast<BigIntValue>()) return big->toString();
+            return formatReal(number());
+        }
+        case ValueType::BOOLEAN: return boolean() ? "#t" : "#f";
+        case ValueType::NIL: return "()";
+        case ValueType::STRING: return cast<StringValue>()->toString();
+        case ValueType::SYMBOL: return cast<SymbolValue>()->toString();
+        case ValueType::PAIR: return cast<PairValue>()->toString();
+        case ValueType::VECTOR: return cast<VectorValue>()->toString();
+        case ValueType::F64VECTOR: return cast<F64VectorValue>()->toString();
+        case ValueType::BUILTIN_PROC:
+            return cast<BuiltinProcValue>()->toString();
+        case ValueType::LAMBDA: return cast<LambdaValue>()->toString();
+        case ValueType::SCOPE: return cast<ScopeValue>()->toString();
+        case ValueType::ENVIRONMENT: return cast<EvalEnv>()->toString();
+    }
+    return "";  // unreachable
+}
 
-std::vector<ValuePtr> Value::toVector() const {
+std::vector<ValuePtr> ValuePtr::toVector() const {
     std::vector<ValuePtr> vec;
-    if (this->type == ValueType::NIL) return vec;
-    if (auto pr = dynamic_cast<const PairValue*>(this)) {
-        vec.push_back(pr->car());
-        auto rest = pr->cdr()->toVector();
-        vec.insert(vec.end(), rest.begin(), rest.end());
-        return vec;
+    auto it = ListIterator(*this);
+    for (; it != std::default_sentinel; ++it) vec.push_back(*it);
+    if (!it.tail().isNil()) throw TypeError(toString() + " is not a list");
+    return vec;
+}
+
+ValuePtr ValuePtr::fromBigInt(BigInt num) {
+    if (auto small = num.toInt64();
+        small && *small >= FIXNUM_MIN && *small <= FIXNUM_MAX)
+        return fromInteger(*small);
+    return Value::make<BigIntValue>(std::move(num));
+}
+
+std::optional<ValuePtr> parseInteger(std::string_view text) {
+    // most integers are fixnums, read without building a BigInt
+    auto digits = withoutPlus(text);
+    std::int64_t value;
+    auto end = digits.data() + digits.size();
+    auto [ptr, ec] = std::from_chars(digits.data(), end, value);
+    if (ec == std::errc{} && ptr == end) return ValuePtr::fromInteger(value);
+
+    if (auto big = BigInt::parse(text)) return ValuePtr::fromBigInt(*big);
+    return std::nullopt;
+}
+
+std::optional<double> parseReal(std::string_view text) {
+    text = withoutPlus(text);
+    double value;
+    auto end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, value);
+    if (ptr != end) return std::nullopt;
+    if (ec == std::errc::result_out_of_range) {
+        // rounds to infinity or to 0
+        auto negative = text.starts_with('-');
+        auto magnitude = orderOfMagnitude(text.substr(negative));
+        value = magnitude > 0 ? HUGE_VAL : 0.0;
+        return negative ? -value : value;
     }
-    throw TypeError(this->toString() + " is not a list");
+    if (ec != std::errc{}) return std::nullopt;
+    return value;
 }
 
-bool Value::asBool() const {
-    if (auto num = dynamic_cast<const BooleanValue*>(this))
-        return num->getVal();
-    throw TypeError(this->toString() + " is not a boolean!");
+bool ValuePtr::asBool() const {
+    if (isBool()) return boolean();
+    throw TypeError(toString() + " is not a boolean!");
 }
 
-double Value::asNumber() const {
-    if (auto num = dynamic_cast<const NumericValue*>(this))
-        return num->getVal();
-    throw TypeError(this->toString() + " is not a number!");
+double ValuePtr::asNumber() const {
+    if (isFlonum()) return number();
+    if (isFixnum()) return static_cast<double>(fixnum());
+    if (auto big = cast<BigIntValue>()) return big->getVal().toDouble();
+    throw TypeError(toString() + " is not a number!");
 }
 
-std::string Value::asString() const {
-    if (auto str = dynamic_cast<const StringValue*>(this)) return str->getVal();
-    throw TypeError(this->toString() + " is not a string!");
+std::string_view ValuePtr::asString() const {
+    if (auto str = cast<StringValue>()) return str->getVal();
+    throw TypeError(toString() + " is not a string!");
 }
 
-std::string Value::asSymbol() const {
-    if (auto sym = dynamic_cast<const SymbolValue*>(this))
-        return sym->toString();
-    throw TypeError(this->toString() + " is not a symbol!");
+std::string ValuePtr::asSymbol() const {
+    if (auto sym = cast<SymbolValue>()) return sym->getName();
+    throw TypeError(toString() + " is not a symbol!");
 }
 
-bool Value::isBoolean(ValuePtr expr) {
-    return typeid(*expr) == typeid(BooleanValue);
+SymbolId ValuePtr::asSymbolId() const {
+    if (auto sym = cast<SymbolValue>()) return sym->getId();
+    throw TypeError(toString() + " is not a symbol!");
 }
 
-bool Value::isNumeric(ValuePtr expr) {
-    return typeid(*expr) == typeid(NumericValue);
+bool Value::isBoolean(const ValuePtr& expr) {
+    return expr.getType() == ValueType::BOOLEAN;
 }
 
-bool Value::isString(ValuePtr expr) {
-    return typeid(*expr) == typeid(StringValue);
+bool Value::isNumeric(const ValuePtr& expr) {
+    return expr.getType() == ValueType::NUMERIC;
 }
 
-bool Value::isSymbol(ValuePtr expr) {
-    return typeid(*expr) == typeid(SymbolValue);
+bool Value::isString(const ValuePtr& expr) {
+    return expr.getType() == ValueType::STRING;
 }
 
-bool Value::isNil(ValuePtr expr) {
-    return typeid(*expr) == typeid(NilValue);
+bool Value::isSymbol(const ValuePtr& expr) {
+    return expr.getType() == ValueType::SYMBOL;
 }
 
-bool Value::isPair(ValuePtr expr) {
-    return typeid(*expr) == typeid(PairValue);
+bool Value::isNil(const ValuePtr& expr) {
+    return expr.getType() == ValueType::NIL;
 }
 
-bool Value::isList(ValuePtr expr) {
-    if (auto pr = dynamic_cast<const PairValue*>(expr.get()))
-        return isList(pr->cdr());
-    if (typeid(*expr) == typeid(NilValue)) return true;
-    return false;
+bool Value::isPair(const ValuePtr& expr) {
+    return expr.getType() == ValueType::PAIR;
 }
 
-bool Value::isProcedure(ValuePtr expr) {
-    return typeid(*expr) == typeid(LambdaValue) ||
-           typeid(*expr) == typeid(BuiltinProcValue);
+bool Value::isList(const ValuePtr& expr) {
+    auto it = ListIterator(expr);
+    while (it != std::default_sentinel) ++it;
+    return isNil(it.tail());
 }
 
-bool Value::isSelfEvaluating(ValuePtr expr) {
-    return typeid(*expr) == typeid(NumericValue) ||
-           typeid(*expr) == typeid(BooleanValue) ||
-           typeid(*expr) == typeid(StringValue);
+bool Value::isProcedure(const ValuePtr& expr) {
+    switch (expr.getType()) {
+        case ValueType::BUILTIN_PROC:
+        case ValueType::LAMBDA: return true;
+        default: return false;
+    }
 }
 
-bool Value::isVirtual(ValuePtr expr) {
-    if (auto boolean = dynamic_cast<const BooleanValue*>(expr.get()))
-        return !boolean->getVal();
-    return false;
+bool Value::isSelfEvaluating(const ValuePtr& expr) {
+    switch (expr.getType()) {
+        case ValueType::NUMERIC:
+        case ValueType::BOOLEAN:
+        case ValueType::STRING:
+        case ValueType::VECTOR: return true;
+        default: return false;
+    }
 }
 
-std::string Value::toString() const {
-    return "";
+bool Value::isVirtual(const ValuePtr& expr) {
+    return expr.isBool() && !expr.boolean();
 }
 
-std::string BooleanValue::toString() const {
-    return value == true ? "#t" : "#f";
+// values account to the Heap for the storage they hold outside their cells
+
+BigIntValue::BigIntValue(BigInt value)
+    : Value(ValueType::NUMERIC), value{std::move(value)} {
+    Heap::instance().addExternal(this->value.storageSize());
 }
 
-bool BooleanValue::getVal() const {
-    return value;
+BigIntValue::~BigIntValue() {
+    Heap::instance().removeExternal(value.storageSize());
 }
 
-double NumericValue::getVal() const {
-    return value;
+std::string BigIntValue::toString() const {
+    return value.toString();
+}
+
+VectorValue::VectorValue(std::vector<ValuePtr> elements)
+    : Value(ValueType::VECTOR), elements{std::move(elements)} {
+    Heap::instance().addExternal(this->elements.size() * sizeof(ValuePtr));
+}
+
+VectorValue::~VectorValue() {
+    Heap::instance().removeExternal(elements.size() * sizeof(ValuePtr));
+}
+
+void VectorValue::set(std::size_t i, ValuePtr val) {
+    Heap::instance().writeBarrier(this, val);
+    elements[i] = val;
+}
+
+void VectorValue::fill(ValuePtr val) {
+    Heap::instance().writeBarrier(this, val);
+    std::ranges::fill(elements, val);
+}
+
+std::string VectorValue::toString() const {
+    std::string res{"#("};
+    for (std::size_t i = 0; i != elements.size(); ++i) {
+        if (i != 0) res.push_back(' ');
+        res.append(elements[i].toString());
+    }
+    res.push_back(')');
+    return res;
+}
+
+void VectorValue::trace(Tracer& tracer) const {
+    for (auto& element : elements) tracer.mark(element);
+}
+
+F64VectorValue::F64VectorValue(std::vector<double> elements)
+    : Value(ValueType::F64VECTOR), elements{std::move(elements)} {
+    Heap::instance().addExternal(this->elements.size() * sizeof(double));
+}
+
+F64VectorValue::~F64VectorValue() {
+    Heap::instance().removeExternal(elements.size() * sizeof(double));
 }
 
-std::string NumericValue::toString() const {
-    return fmod(value, 1.0) == 0.0 ? std::to_string(static_cast<int>(value))
-                                   : std::to_string(value);
+std::string F64VectorValue::toString() const {
+    std::string res{"#f64("};
+    for (std::size_t i = 0; i != elements.size(); ++i) {
+        if (i != 0) res.push_back(' ');
+        res.append(formatReal(elements[i]));
+    }
+    res.push_back(')');
+    return res;
+}
+
+StringValue::StringValue(std::string str)
+    : Value(ValueType::STRING), str{std::move(str)}, length{this->str.size()} {
+    Heap::instance().addExternal(this->str.size());
+}
+
+StringValue::~StringValue() {
+    Heap::instance().removeExternal(str.size());
 }
 
 std::string StringValue::toString() const {
     std::ostringstream oss;
-    oss << std::quoted(str);
+    oss << std::quoted(getVal());
     return oss.str();
 }
 
-std::string StringValue::getVal() const {
-    return str;
+ValuePtr StringValue::from(std::string str) {
+    static const auto shared = [] {
+        std::array<ValuePtr, 257> strings;
+        strings[0] = makeImmortal<StringValue>("");
+        for (int c = 0; c != 256; ++c)
+            strings[c + 1] =
+                makeImmortal<StringValue>(std::string(1, static_cast<char>(c)));
+        return strings;
+    }();
+    if (str.empty()) return shared[0];
+    if (str.size() == 1) return shared[static_cast<unsigned char>(str[0]) + 1];
+    return make<StringValue>(std::move(str));
 }
 
-std::string NilValue::toString() const {
-    return "()";
+namespace {
+const StringValue& checkString(const ValuePtr& val) {
+    if (auto str = val.cast<StringValue>()) return *str;
+    throw TypeError(val.toString() + " is not a string!");
 }
-
-std::string SymbolValue::toString() const {
-    return name;
+}  // namespace
+
+ValuePtr StringValue::concat(const ValuePtr& lhs, const ValuePtr& rhs) {
+    auto& lstr = checkString(lhs);
+    auto& rstr = checkString(rhs);
+    auto length = lstr.size() + rstr.size();
+    if (lstr.size() == 0) return rhs;
+    if (rstr.size() == 0) return lhs;
+    if (length < SHARE_MIN) {
+        std::string res{lstr.getVal()};
+        res.append(rstr.getVal());
+        return from(std::move(res));
+    }
+    return make<StringValue>(lhs, rhs, length);
 }
 
-void PairValue::toStringRecursive(std::string& res,
-                                  const PairValue& pair) const {
-    auto l_part{pair.l_part};
-    auto r_part{pair.r_part};
+ValuePtr StringValue::substr(const ValuePtr& str, std::size_t pos,
+                             std::size_t n) {
+    auto& string = checkString(str);
+    n = std::min(n, string.size() - pos);
+    if (n == string.size()) return str;
+    if (n < SHARE_MIN) return from(std::string(string.getVal().substr(pos, n)));
 
-    res.append(l_part->toString());
+    string.flatten();
+    if (string.left.isNil()) return make<StringValue>(str, pos, n);
+    return make<StringValue>(string.left, string.offset + pos, n);
+}
 
-    if (isNil(r_part))
-        return;
-    else if (auto rp = dynamic_pointer_cast<PairValue>(r_part)) {
-        res.push_back(' ');
-        rp->toStringRecursive(res, *rp);
-    } else {
-        res.append(" . ");
-        res.append(r_part->toString());
+void StringValue::flatten() const {
+    if (right.isNil()) return;  // flat or a slice already
+
+    // iterative, as a long rope is as deep as the appends that built it
+    Heap::instance().reserve(length);
+    std::string res;
+    res.reserve(length);
+    std::vector<const StringValue*> pending{this};
+    while (!pending.empty()) {
+        auto string = pending.back();
+        pending.pop_back();
+        if (string->right.isNil()) {
+            res.append(string->getVal());
+        } else {
+            pending.push_back(string->right.cast<StringValue>());
+            pending.push_back(string->left.cast<StringValue>());
+        }
     }
+    str = std::move(res);
+    left = right = ValuePtr::nil();
+    Heap::instance().addExternal(length);
+}
+
+std::string_view StringValue::getVal() const {
+    flatten();
+    if (left.isNil()) return str;
+    return std::string_view{left.cast<StringValue>()->str}.substr(offset,
+                                                                  length);
+}
+
+void StringValue::trace(Tracer& tracer) const {
+    tracer.mark(left);
+    tracer.mark(right);
+}
+
+namespace {
+// symbols are immortal, so the views into names stay valid
+struct SymbolTable {
+    std::vector<ValuePtr> by_id;
+    std::unordered_map<std::string_view, SymbolId> by_name;
+};
+
+SymbolTable& symbolTable() {
+    static SymbolTable table;
+    return table;
+}
+}  // namespace
+
+ValuePtr SymbolValue::intern(std::string_view name) {
+    auto& table = symbolTable();
+    if (auto it = table.by_name.find(name); it != table.by_name.end())
+        return table.by_id[it->second];
+
+    auto id = static_cast<SymbolId>(table.by_id.size());
+    auto& forms = SpecialForm::form_list;
+    auto form = forms.find(std::string(name));
+    auto sym = makeImmortal<SymbolValue>(
+        std::string(name), id, form == forms.end() ? nullptr : form->second);
+    table.by_id.push_back(sym);
+    table.by_name.emplace(sym.cast<SymbolValue>()->name, id);
+    return sym;
+}
+
+ValuePtr SymbolValue::fromId(SymbolId id) {
+    return symbolTable().by_id.at(id);
+}
+
+std::string SymbolValue::toString() const {
+    return name;
 }
 
 std::string PairValue::toString() const {
     std::string res{"("};
-    toStringRecursive(res, *this);
+    auto pair = this;
+    while (true) {
+        res.append(pair->l_part.toString());
+        if (isNil(pair->r_part)) break;
+        if (auto next = pair->r_part.cast<PairValue>()) {
+            res.push_back(' ');
+            pair = next;
+        } else {
+            res.append(" . ");
+            res.append(pair->r_part.toString());
+            break;
+        }
+    }
     res.push_back(')');
     return res;
 }
 
-ValuePtr Value::makeList(const std::vector<ValuePtr>& lst) {
-    if (lst.empty()) return std::make_shared<NilValue>();
+void PairValue::trace(Tracer& tracer) const {
+    tracer.mark(l_part);
+    tracer.mark(r_part);
+}
 
-    return std::make_shared<PairValue>(lst.front(),
-                                       makeList({lst.begin() + 1, lst.end()}));
+ValuePtr Value::makeList(const std::vector<ValuePtr>& lst) {
+    // allocating does not collect, so the pairs built need no rooting
+    auto list = ValuePtr::nil();
+    for (auto it = lst.rbegin(); it != lst.rend(); ++it)
+        list = make<PairValue>(*it, list);
+    return list;
 }
 
 std::string BuiltinProcValue::toString() const {
     return "#<procedure>";
 }
 
-std::function<BuiltinFuncType> BuiltinProcValue::getVal() const {
-    return func;
-}
-
-ValuePtr LambdaValue::apply(const std::vector<ValuePtr>& args) const {
-    auto env = this->envPtr->EvalEnv::createChild(this->params, args);
-    for (std::size_t i = 0; i < this->body.size() - 1; ++i) {
-        env->eval(this->body[i]);
-    }
-    return env->eval(this->body.back());
+EvalEnv* LambdaValue::createFrame(std::span<const ValuePtr> args) const {
+    return envPtr->createChild(scope, args);
 }
 
 std::string LambdaValue::toString() const {
     return "#<procedure>";
 }
+
+void LambdaValue::trace(Tracer& tracer) const {
+    // constants of the body are pinned by the nodes holding them
+    tracer.mark(scope);
+    tracer.mark(envPtr);
+}
+
+int ScopeValue::slotOf(SymbolId name) const {
+    for (std::size_t i = 0; i != names.size(); ++i)
+        if (names[i] == name) return static_cast<int>(i);
+    return -1;
+}
+
+std::string ScopeValue::toString() const {
+    std::vector<ValuePtr> params;
+    for (std::size_t i = 0; i != param_count; ++i)
+        params.push_back(SymbolValue::fromId(names[i]));
+    return makeList(params).toString();
+}
@@ -1,113 +1,377 @@
 #ifndef VALUE_H
 #define VALUE_H
 
-#include <functional>
-#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
 #include <memory>
+#include <new>
+#include <optional>
+#include <ranges>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
+#include "./bigint.h"
+
+class Analyzer;
 class EvalEnv;
+class Node;
+class Tracer;
 
-enum class ValueType {
+enum class ValueType : std::uint8_t {
     BOOLEAN,
     NUMERIC,
     STRING,
     NIL,
     SYMBOL,
     PAIR,
+    VECTOR,
+    F64VECTOR,
     BUILTIN_PROC,
-    LAMBDA
+    LAMBDA,
+    SCOPE,
+    ENVIRONMENT
 };
+constexpr std::size_t VALUE_TYPE_COUNT =
+    static_cast<std::size_t>(ValueType::ENVIRONMENT) + 1;
 
 class Value;
 
-using ValuePtr = std::shared_ptr<Value>;
-using BuiltinFuncType = ValuePtr(const std::vector<ValuePtr>&, EvalEnv&);
+using SymbolId = std::uint32_t;
 
-class Value {
+// NaN-boxed handle to a value. Doubles are stored as their own bit pattern,
+// exact integers of 48 bits (fixnums), booleans and () live in the payload
+// of negative quiet NaNs, and only heap objects (strings, symbols, pairs,
+// vectors, procedures, larger integers) carry a pointer. Copies are
+// plain bit copies: heap objects are owned by the collector (see gc.h).
+class ValuePtr {
 private:
-    ValueType type;
+    // every tag lies above the canonical NaN, so no double collides with it
+    static constexpr std::uint64_t TAG_MASK = 0xFFFF'0000'0000'0000;
+    static constexpr std::uint64_t PAYLOAD_MASK = 0x0000'FFFF'FFFF'FFFF;
+    static constexpr std::uint64_t HEAP_TAG = 0xFFF9'0000'0000'0000;
+    static constexpr std::uint64_t BOOLEAN_TAG = 0xFFFA'0000'0000'0000;
+    static constexpr std::uint64_t NIL_TAG = 0xFFFB'0000'0000'0000;
+    static constexpr std::uint64_t FIXNUM_TAG = 0xFFFC'0000'0000'0000;
+    static constexpr std::uint64_t UNASSIGNED = 0xFFFD'0000'0000'0000;
+    static constexpr std::uint64_t CANONICAL_NAN = 0x7FF8'0000'0000'0000;
 
-protected:
-    Value(ValueType type) : type{type} {}
+    std::uint64_t bits;
+
+    explicit ValuePtr(std::uint64_t bits) : bits{bits} {}
 
 public:
-    virtual ~Value() = 0;
-    virtual std::string toString() const = 0;
+    // range of the exact integers stored inline
+    static constexpr std::int64_t FIXNUM_MIN = -(std::int64_t{1} << 47);
+    static constexpr std::int64_t FIXNUM_MAX = (std::int64_t{1} << 47) - 1;
+
+    ValuePtr() : bits{NIL_TAG} {}
+    explicit ValuePtr(Value* ptr)
+        : bits{HEAP_TAG | reinterpret_cast<std::uintptr_t>(ptr)} {}
+
+    static ValuePtr fromNumber(double num) {
+        std::uint64_t raw;
+        std::memcpy(&raw, &num, sizeof raw);
+        return ValuePtr(num != num ? CANONICAL_NAN : raw);
+    }
+    // exact integers: a fixnum when in range, a BigIntValue otherwise
+    static ValuePtr fromInteger(std::int64_t num) {
+        if (num < FIXNUM_MIN || num > FIXNUM_MAX) return fromBigInt(num);
+        return ValuePtr(FIXNUM_TAG |
+                        (static_cast<std::uint64_t>(num) & PAYLOAD_MASK));
+    }
+    static ValuePtr fromBigInt(BigInt num);
+    static ValuePtr fromBool(bool boolean) {
+        return ValuePtr(BOOLEAN_TAG | boolean);
+    }
+    static ValuePtr nil() {
+        return ValuePtr(NIL_TAG);
+    }
+    // content of a frame slot whose define has not run yet; never seen by
+    // Lisp code, as reading the slot fails
+    static ValuePtr unassigned() {
+        return ValuePtr(UNASSIGNED);
+    }
+
+    bool isNumber() const;
+    bool isFlonum() const {
+        return bits < HEAP_TAG;
+    }
+    bool isFixnum() const {
+        return (bits & TAG_MASK) == FIXNUM_TAG;
+    }
+    bool isBignum() const;
+    bool isExactInteger() const {
+        return isFixnum() || isBignum();
+    }
+    bool isBool() const {
+        return (bits & TAG_MASK) == BOOLEAN_TAG;
+    }
+    bool isNil() const {
+        return bits == NIL_TAG;
+    }
+    bool isUnassigned() const {
+        return bits == UNASSIGNED;
+    }
+    bool isHeap() const {
+        return (bits & TAG_MASK) == HEAP_TAG;
+    }
+
+    // unchecked payload accessors, valid only after the matching isXxx()
+    double number() const {  // isFlonum()
+        double num;
+        std::memcpy(&num, &bits, sizeof num);
+        return num;
+    }
+    std::int64_t fixnum() const {
+        return static_cast<std::int64_t>(bits << 16) >> 16;  // sign-extended
+    }
+    bool boolean() const {
+        return bits & 1;
+    }
+    Value* get() const {
+        return isHeap() ? reinterpret_cast<Value*>(bits & PAYLOAD_MASK)
+                        : nullptr;
+    }
+
+    ValueType getType() const;
+
+    // checked static down-cast: nullptr unless the tag matches T::TYPE
+    template <typename T>
+    T* cast() const;
+
+    std::string toString() const;
     std::vector<ValuePtr> toVector() const;
 
     bool asBool() const;
-    double asNumber() const;
-    std::string asString() const;
+    double asNumber() const;  // exact integers are converted
+    std::string_view asString() const;
     std::string asSymbol() const;
+    SymbolId asSymbolId() const;
 
-    static bool isBoolean(ValuePtr expr);
-    static bool isNumeric(ValuePtr expr);
-    static bool isString(ValuePtr expr);
-    static bool isSymbol(ValuePtr expr);
-    static bool isNil(ValuePtr expr);
-    static bool isPair(ValuePtr expr);
+    // identity: same immediate bits or same heap object
+    friend bool operator==(const ValuePtr& lhs, const ValuePtr& rhs) {
+        return lhs.bits == rhs.bits;
+    }
+};
 
-    static bool isList(ValuePtr expr);
-    static bool isProcedure(ValuePtr expr);
-    static bool isSelfEvaluating(ValuePtr expr);
-    static bool isVirtual(ValuePtr expr);  // true iff expr == #f
+// the exact integer `text` spells in decimal, with an optional sign
+std::optional<ValuePtr> parseInteger(std::string_view text);
+// the double `text` spells in decimal or scientific notation, with an
+// optional sign; neither throws on text that is not a number
+std::optional<double> parseReal(std::string_view text);
 
-    static ValuePtr makeList(const std::vector<ValuePtr>& lst);
-};
+using BuiltinFuncType = ValuePtr(std::span<const ValuePtr>, EvalEnv&);
+// A special form is analyzed rather than evaluated: it turns its operands,
+// unevaluated, into the node that runs it.
+using SpecialFormType = std::shared_ptr<const Node>(
+    const std::vector<ValuePtr>&, Analyzer&);
+
+class Value {
+    friend class Heap;
+    friend class Tracer;
 
-class BooleanValue : public Value {
 private:
-    bool value;
+    ValueType type;
+    bool marked{false};
+    bool old{false};          // survived a collection
+    bool remembered{false};   // old, and may point to young values
+    std::uint32_t pins{0};    // see Pinned
+
+protected:
+    Value(ValueType type) : type{type} {}
+    ~Value() = default;  // values are destroyed by the Heap, by type
+
+    // memory for a new object, which is then handed over to the Heap
+    static void* allocate(std::size_t size);
+    static void deallocate(void* cell, std::size_t size);
+    static void track(Value* obj);
+    // memory for an immortal object, never freed
+    static void* allocateImmortal(std::size_t size, std::size_t align);
 
 public:
-    BooleanValue(bool value) : Value(ValueType::BOOLEAN), value{value} {};
-    bool getVal() const;
-    std::string toString() const final;
+    // largest object the Heap allocates
+    static constexpr std::size_t MAX_SIZE = 128;
+
+    Value(const Value&) = delete;
+    Value& operator=(const Value&) = delete;
+
+    ValueType getType() const {
+        return type;
+    }
+
+    template <typename T, typename... Args>
+    static ValuePtr make(Args&&... args) {
+        static_assert(sizeof(T) <= MAX_SIZE);
+        auto cell = allocate(sizeof(T));
+        T* obj;
+        try {
+            obj = new (cell) T(std::forward<Args>(args)...);
+        } catch (...) {
+            deallocate(cell, sizeof(T));  // e.g. its storage did not fit
+            throw;
+        }
+        track(obj);
+        return ValuePtr(obj);
+    }
+    // An immortal value lives outside the Heap until the process exits. It
+    // is born marked and old, so collections neither trace nor sweep it and
+    // the write barrier ignores it.
+    template <typename T, typename... Args>
+    static ValuePtr makeImmortal(Args&&... args) {
+        auto obj = new (allocateImmortal(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+        obj->marked = true;
+        obj->old = true;
+        return ValuePtr(obj);
+    }
+
+    static bool isBoolean(const ValuePtr& expr);
+    static bool isNumeric(const ValuePtr& expr);
+    static bool isString(const ValuePtr& expr);
+    static bool isSymbol(const ValuePtr& expr);
+    static bool isNil(const ValuePtr& expr);
+    static bool isPair(const ValuePtr& expr);
+
+    static bool isList(const ValuePtr& expr);
+    static bool isProcedure(const ValuePtr& expr);
+    static bool isSelfEvaluating(const ValuePtr& expr);
+    static bool isVirtual(const ValuePtr& expr);  // true iff expr == #f
+
+    static ValuePtr makeList(const std::vector<ValuePtr>& lst);
 };
 
-class NumericValue : public Value {
+inline ValueType ValuePtr::getType() const {
+    if (isFlonum() || isFixnum()) return ValueType::NUMERIC;
+    if (isBool()) return ValueType::BOOLEAN;
+    if (isNil()) return ValueType::NIL;
+    return get()->getType();
+}
+
+template <typename T>
+T* ValuePtr::cast() const {
+    return isHeap() && get()->getType() == T::TYPE ? static_cast<T*>(get())
+                                                   : nullptr;
+}
+
+inline bool ValuePtr::isNumber() const {
+    return getType() == ValueType::NUMERIC;
+}
+
+inline bool ValuePtr::isBignum() const {
+    return isHeap() && get()->getType() == ValueType::NUMERIC;
+}
+
+// An exact integer beyond the fixnum range. It is a number like any other,
+// so its type is NUMERIC; fixnums and doubles are never stored here.
+class BigIntValue : public Value {
 private:
-    double value;
+    const BigInt value;
 
 public:
-    NumericValue(double value) : Value(ValueType::NUMERIC), value{value} {}
-    double getVal() const;
-    std::string toString() const final;
+    static constexpr ValueType TYPE = ValueType::NUMERIC;
+    BigIntValue(BigInt value);
+    ~BigIntValue();
+
+    const BigInt& getVal() const {
+        return value;
+    }
+    std::string toString() const;
 };
 
+// Strings are immutable, so they share storage: a string is either flat,
+// owning its characters, a slice of a flat string, or a rope joining two
+// strings, which a repeated string-append builds in linear time. A rope is
+// flattened in place the first time its characters are read.
 class StringValue : public Value {
+    friend class Value;
+
 private:
-    std::string str;
+    // results shorter than this are copied rather than shared
+    static constexpr std::size_t SHARE_MIN = 64;
 
-public:
-    StringValue(const std::string str) : Value(ValueType::STRING), str{str} {}
-    std::string getVal() const;
-    std::string toString() const final;
-};
+    mutable std::string str;   // if flat
+    mutable ValuePtr left;     // left half of a rope, or base of a slice
+    mutable ValuePtr right;    // right half of a rope
+    mutable std::size_t offset{0};  // in the base of a slice
+    std::size_t length;
+
+    StringValue(ValuePtr base, std::size_t offset, std::size_t length)
+        : Value(ValueType::STRING),
+          left{base},
+          offset{offset},
+          length{length} {}
+    StringValue(ValuePtr left, ValuePtr right, std::size_t length)
+        : Value(ValueType::STRING), left{left}, right{right}, length{length} {}
+    void flatten() const;
 
-class NilValue : public Value {
 public:
-    NilValue() : Value(ValueType::NIL) {}
-    std::string toString() const final;
+    static constexpr ValueType TYPE = ValueType::STRING;
+    StringValue(std::string str);
+    ~StringValue();
+
+    // the empty and one-character strings are shared immortals; others are
+    // allocated
+    static ValuePtr from(std::string str);
+    // `lhs` followed by `rhs`, both strings
+    static ValuePtr concat(const ValuePtr& lhs, const ValuePtr& rhs);
+    // at most `n` characters of the string `str` from `pos` <= its size
+    static ValuePtr substr(const ValuePtr& str, std::size_t pos, std::size_t n);
+
+    std::size_t size() const {
+        return length;
+    }
+    std::string_view getVal() const;
+    std::string toString() const;
+    void trace(Tracer& tracer) const;
 };
 
+// Symbols are interned: each distinct name has exactly one immortal
+// SymbolValue, so symbols compare by identity and are keyed by id. A symbol
+// naming a special form carries it, so keywords are recognized without a
+// lookup by name.
 class SymbolValue : public Value {
+    friend class Value;
+
 private:
     const std::string name;
+    const SymbolId id;
+    SpecialFormType* const form;
+
+    SymbolValue(const std::string& name, SymbolId id, SpecialFormType* form)
+        : Value(ValueType::SYMBOL), name{name}, id{id}, form{form} {}
 
 public:
-    SymbolValue(const std::string value)
-        : Value(ValueType::SYMBOL), name{value} {}
-    std::string toString() const final;
+    static constexpr ValueType TYPE = ValueType::SYMBOL;
+
+    static ValuePtr intern(std::string_view name);
+    static ValuePtr fromId(SymbolId id);
+
+    SymbolId getId() const {
+        return id;
+    }
+    const std::string& getName() const {
+        return name;
+    }
+    // special form named by this symbol, or nullptr
+    SpecialFormType* getForm() const {
+        return form;
+    }
+    std::string toString() const;
 };
 
 class PairValue : public Value {
+    friend class ListBuilder;
+
 private:
     ValuePtr l_part;
     ValuePtr r_part;
-    void toStringRecursive(std::string& res, const PairValue& pair) const;
 
 public:
+    static constexpr ValueType TYPE = ValueType::PAIR;
     PairValue(ValuePtr l_part, ValuePtr r_part)
         : Value(ValueType::PAIR), l_part{l_part}, r_part{r_part} {}
     ValuePtr car() const {
@@ -116,37 +380,164 @@ public:
     ValuePtr cdr() const {
         return r_part;
     }
-    std::string toString() const final;
+    std::string toString() const;
+    void trace(Tracer& tracer) const;
+};
+
+// A vector of any values, with constant-time access. Its elements may be
+// set, through set() and fill(), which take the write barrier.
+class VectorValue : public Value {
+private:
+    std::vector<ValuePtr> elements;
+
+public:
+    static constexpr ValueType TYPE = ValueType::VECTOR;
+    VectorValue(std::vector<ValuePtr> elements);
+    ~VectorValue();
+
+    std::span<const ValuePtr> getVal() const {
+        return elements;
+    }
+    void set(std::size_t i, ValuePtr val);
+    void fill(ValuePtr val);
+    std::string toString() const;
+    void trace(Tracer& tracer) const;
+};
+
+// A homogeneous vector of doubles, stored contiguously for the kernels of
+// simd.h. Unlike the other values its elements may be set, but they are no
+// references, so setting them needs no write barrier.
+class F64VectorValue : public Value {
+private:
+    std::vector<double> elements;
+
+public:
+    static constexpr ValueType TYPE = ValueType::F64VECTOR;
+    F64VectorValue(std::vector<double> elements);
+    ~F64VectorValue();
+
+    std::span<double> getVal() {
+        return elements;
+    }
+    std::string toString() const;
+};
+
+// Forward iterator over the elements of a list, pair by pair. It stops at
+// the first cdr that is not a pair, so use Value::isList first where an
+// improper tail is an error.
+class ListIterator {
+private:
+    ValuePtr rest;
+
+public:
+    using value_type = ValuePtr;
+    using difference_type = std::ptrdiff_t;
+
+    ListIterator() = default;
+    explicit ListIterator(ValuePtr list) : rest{list} {}
+
+    ValuePtr operator*() const {
+        return rest.cast<PairValue>()->car();
+    }
+    ListIterator& operator++() {
+        rest = rest.cast<PairValue>()->cdr();
+        return *this;
+    }
+    ListIterator operator++(int) {
+        auto it = *this;
+        ++*this;
+        return it;
+    }
+    // the list from this element on
+    ValuePtr tail() const {
+        return rest;
+    }
+    friend bool operator==(const ListIterator& it, std::default_sentinel_t) {
+        return !it.rest.cast<PairValue>();
+    }
 };
 
+// the elements of `list`, for range-for and <ranges>
+inline auto listElements(ValuePtr list) {
+    return std::ranges::subrange(ListIterator(list), std::default_sentinel);
+}
+
+// A builtin called through a plain function pointer. Its arity is checked
+// by the caller (EvalEnv::apply), so the function itself may assume it.
 class BuiltinProcValue : public Value {
 private:
-    std::function<BuiltinFuncType> func;
+    BuiltinFuncType* func;
+    std::size_t min_args;
+    std::size_t max_args;
 
 public:
-    BuiltinProcValue(std::function<BuiltinFuncType> func)
-        : Value(ValueType::BUILTIN_PROC), func{func} {}
-    std::string toString() const final;
-    std::function<BuiltinFuncType> getVal() const;
+    static constexpr ValueType TYPE = ValueType::BUILTIN_PROC;
+    BuiltinProcValue(BuiltinFuncType* func, std::size_t min_args,
+                     std::size_t max_args)
+        : Value(ValueType::BUILTIN_PROC),
+          func{func},
+          min_args{min_args},
+          max_args{max_args} {}
+    std::string toString() const;
+
+    BuiltinFuncType* getVal() const {
+        return func;
+    }
+    std::size_t getMinArgs() const {
+        return min_args;
+    }
+    std::size_t getMaxArgs() const {
+        return max_args;
+    }
 };
 
 class LambdaValue : public Value {
 private:
-    std::vector<std::string> params;
-    std::vector<ValuePtr> body;
-    std::shared_ptr<EvalEnv> envPtr;
+    ValuePtr scope;  // ScopeValue of the frames created by createFrame
+    std::shared_ptr<const Node> body;
+    EvalEnv* envPtr;
 
 public:
-    LambdaValue(std::vector<std::string> params, std::vector<ValuePtr> body,
-                std::shared_ptr<EvalEnv> envPtr)
+    static constexpr ValueType TYPE = ValueType::LAMBDA;
+    LambdaValue(ValuePtr scope, std::shared_ptr<const Node> body,
+                EvalEnv* envPtr)
         : Value(ValueType::LAMBDA),
-          params{params},
-          body{body},
+          scope{scope},
+          body{std::move(body)},
           envPtr{envPtr} {}
 
-    // eval args by envPtr->env(), then apply them to lambda
-    ValuePtr apply(const std::vector<ValuePtr>& args) const;
-    std::string toString() const final;
+    // frame binding `args` under envPtr, in which the body runs
+    EvalEnv* createFrame(std::span<const ValuePtr> args) const;
+    const Node& getBody() const {
+        return *body;
+    }
+    std::string toString() const;
+    void trace(Tracer& tracer) const;
+};
+
+// Binding list of an analyzed lambda or let: names every slot of the frame
+// it creates, parameters first, then internal defines.
+class ScopeValue : public Value {
+private:
+    std::vector<SymbolId> names;
+    std::size_t param_count;
+
+public:
+    static constexpr ValueType TYPE = ValueType::SCOPE;
+    ScopeValue(std::vector<SymbolId> names, std::size_t param_count)
+        : Value(ValueType::SCOPE),
+          names{std::move(names)},
+          param_count{param_count} {}
+
+    const std::vector<SymbolId>& getNames() const {
+        return names;
+    }
+    std::size_t getParamCount() const {
+        return param_count;
+    }
+    // slot of `name` in this scope, or -1
+    int slotOf(SymbolId name) const;
+    std::string toString() const;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,244 @@
+#include "./vm.h"
+
+#include <iterator>
+#include <vector>
+
+#include "./error.h"
+#include "./gc.h"
+
+// GCC and Clang dispatch through a table of label addresses (threaded
+// code); other compilers fall back to a switch in a loop.
+#if defined(__GNUC__)
+#define VM_COMPUTED_GOTO 1
+#else
+#define VM_COMPUTED_GOTO 0
+#endif
+
+namespace {
+
+// procedure suspended by a CALL until its callee returns
+struct CallFrame {
+    const Bytecode* code;
+    const std::uint32_t* ip;
+    EvalEnv* env;
+    ValuePtr proc;  // keeps `code` alive
+};
+
+// state of one run of the VM, which the collector sees through the scope
+struct Registers : RootScope {
+    std::vector<ValuePtr> stack;
+    std::vector<CallFrame> callers;
+    EvalEnv* env;
+    ValuePtr proc;  // running procedure, () for the code run was given
+
+    // scratch state of CALL/TAIL_CALL and RETURN
+    ValuePtr result;
+
+    explicit Registers(EvalEnv* env) : env{env} {}
+
+    void trace(Tracer& tracer) const override {
+        for (auto& val : stack) tracer.mark(val);
+        for (auto& caller : callers) {
+            tracer.mark(caller.env);
+            tracer.mark(caller.proc);
+        }
+        tracer.mark(env);
+        tracer.mark(proc);
+        tracer.mark(result);
+    }
+};
+
+}  // namespace
+
+ValuePtr VM::eval(const ValuePtr& expr, EvalEnv* env) {
+    auto bytecode = Compiler::compileTop(expr);
+    return run(bytecode, env);
+}
+
+ValuePtr VM::run(const Bytecode& bytecode, EvalEnv* top_env) {
+    Registers regs{top_env};
+    auto& stack = regs.stack;
+    auto& callers = regs.callers;
+    auto& env = regs.env;
+    auto& proc = regs.proc;
+    auto& result = regs.result;
+    const Bytecode* code = &bytecode;
+    const std::uint32_t* ip = code->code.data();
+    bool is_tail = false;
+
+#if VM_COMPUTED_GOTO
+    // in the order of OpCode
+    static void* const labels[] = {
+        &&op_CONST,         &&op_LOCAL,
+        &&op_GLOBAL,        &&op_DEFINE_LOCAL,
+        &&op_DEFINE,        &&op_POP,
+        &&op_JUMP,          &&op_JUMP_IF_FALSE,
+        &&op_JUMP_IF_FALSE_KEEP, &&op_JUMP_IF_TRUE_KEEP,
+        &&op_CLOSURE,       &&op_ENTER,
+        &&op_LEAVE,         &&op_MAKE_LIST,
+        &&op_EXEC,          &&op_CALL,
+        &&op_TAIL_CALL,     &&op_RETURN,
+    };
+#define VM_CASE(op) op_##op
+#define VM_DISPATCH() goto* labels[*ip++]
+    VM_DISPATCH();
+#else
+#define VM_CASE(op) case OpCode::op
+#define VM_DISPATCH() goto dispatch
+dispatch:
+    switch (static_cast<OpCode>(*ip++)) {
+#endif
+
+    VM_CASE(CONST): {
+        stack.push_back(code->constants[*ip++]);
+        VM_DISPATCH();
+    }
+    VM_CASE(LOCAL): {
+        auto depth = *ip++;
+        stack.push_back(env->lookupLocal(depth, *ip++));
+        VM_DISPATCH();
+    }
+    VM_CASE(GLOBAL): {
+        stack.push_back(env->lookupBinding(*ip++));
+        VM_DISPATCH();
+    }
+    VM_CASE(DEFINE_LOCAL): {
+        env->setLocal(*ip++, std::move(stack.back()));
+        stack.back() = code->constants[*ip++];
+        VM_DISPATCH();
+    }
+    VM_CASE(DEFINE): {
+        auto& name = code->constants[*ip++];
+        env->defineBinding(name, std::move(stack.back()));
+        stack.back() = name;
+        VM_DISPATCH();
+    }
+    VM_CASE(POP): {
+        stack.pop_back();
+        VM_DISPATCH();
+    }
+    VM_CASE(JUMP): {
+        ip = code->code.data() + *ip;
+        VM_DISPATCH();
+    }
+    VM_CASE(JUMP_IF_FALSE): {
+        bool is_false = Value::isVirtual(stack.back());
+        stack.pop_back();
+        ip = is_false ? code->code.data() + *ip : ip + 1;
+        VM_DISPATCH();
+    }
+    VM_CASE(JUMP_IF_FALSE_KEEP): {
+        if (Value::isVirtual(stack.back())) {
+            ip = code->code.data() + *ip;
+        } else {
+            stack.pop_back();
+            ++ip;
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(JUMP_IF_TRUE_KEEP): {
+        if (!Value::isVirtual(stack.back())) {
+            ip = code->code.data() + *ip;
+        } else {
+            stack.pop_back();
+            ++ip;
+        }
+        VM_DISPATCH();
+    }
+    VM_CASE(CLOSURE): {
+        auto& [scope, body] = code->lambdas[*ip++];
+        stack.push_back(Value::make<LambdaValue>(scope, body, env));
+        VM_DISPATCH();
+    }
+    VM_CASE(ENTER): {
+        auto& scope = code->constants[*ip++];
+        auto argc = *ip++;
+        env = env->createChild(scope, {stack.end() - argc, stack.end()});
+        stack.resize(stack.size() - argc);
+        VM_DISPATCH();
+    }
+    VM_CASE(LEAVE): {
+        env = env->parent;
+        VM_DISPATCH();
+    }
+    VM_CASE(MAKE_LIST): {
+        auto n = *ip++;
+        ValuePtr list = ValuePtr::nil();
+        for (std::uint32_t i = 0; i != n; ++i) {
+            list = Value::make<PairValue>(std::move(stack.back()), list);
+            stack.pop_back();
+        }
+        stack.push_back(std::move(list));
+        VM_DISPATCH();
+    }
+    VM_CASE(EXEC): {
+        stack.push_back(code->nodes[*ip++]->exec(*env));
+        VM_DISPATCH();
+    }
+    VM_CASE(CALL): {
+        is_tail = false;
+        goto call;
+    }
+    VM_CASE(TAIL_CALL): {
+        is_tail = true;
+        goto call;
+    }
+    VM_CASE(RETURN): {
+        result = std::move(stack.back());
+        stack.pop_back();
+        goto ret;
+    }
+
+#if !VM_COMPUTED_GOTO
+    }
+#endif
+
+call: {
+    auto argc = *ip++;
+    auto base = stack.size() - argc;
+    ValuePtr callee = std::move(stack[base - 1]);
+
+    auto lambda = callee.cast<LambdaValue>();
+    auto callee_code = lambda ? lambda->getBody().bytecode() : nullptr;
+    if (!callee_code) {
+        // builtins and analyzed lambdas run outside the VM; builtins read
+        // their arguments right off the stack
+        result = env->apply(std::move(callee), {stack.data() + base, argc});
+        stack.resize(base - 1);
+        if (is_tail) goto ret;
+        stack.push_back(std::move(result));
+        VM_DISPATCH();
+    }
+
+    auto frame = lambda->createFrame({stack.data() + base, argc});
+    stack.resize(base - 1);
+
+    if (!is_tail)
+        callers.push_back({code, ip, env, std::move(proc)});
+    code = callee_code;
+    ip = code->code.data();
+    env = frame;
+    proc = std::move(callee);
+    Heap::instance().safepoint();
+    VM_DISPATCH();
+}
+
+ret: {
+    if (callers.empty()) return result;
+    auto& caller = callers.back();
+    code = caller.code;
+    ip = caller.ip;
+    env = caller.env;
+    proc = std::move(caller.proc);
+    callers.pop_back();
+    stack.push_back(std::move(result));
+    VM_DISPATCH();
+}
+
+#undef VM_CASE
+#undef VM_DISPATCH
+}
+
+ValuePtr BytecodeNode::exec(EvalEnv& env, TailCall* tail) const {
+    return VM::run(code, &env);
+}
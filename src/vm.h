@@ -0,0 +1,35 @@
+#ifndef VM_H
+#define VM_H
+
+#include "./analyzer.h"
+#include "./compiler.h"
+#include "./eval_env.h"
+
+// Stack VM running compiled code, an alternative to the tree-walking
+// EvalEnv::eval. It shares frames, builtins and procedures with it: VM
+// lambdas are ordinary LambdaValues whose body is a BytecodeNode.
+namespace VM {
+
+// compiles `expr` and runs it in `env`
+ValuePtr eval(const ValuePtr& expr, EvalEnv* env);
+// `env` must be reachable by the collector, e.g. pinned
+ValuePtr run(const Bytecode& bytecode, EvalEnv* env);
+
+};  // namespace VM
+
+// Lambda body compiled to bytecode. Calls from the VM run it in place; exec
+// starts a new VM for calls from builtins and analyzed code.
+class BytecodeNode : public Node {
+private:
+    Bytecode code;
+
+public:
+    explicit BytecodeNode(Bytecode code) : code{std::move(code)} {}
+
+    ValuePtr exec(EvalEnv& env, TailCall* tail) const override;
+    const Bytecode* bytecode() const override {
+        return &code;
+    }
+};
+
+#endif